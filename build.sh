@@ -2,10 +2,27 @@
 
 set -e
 
+# TRACE=1 ./build.sh compiles the scoped trace markers in (see src/trace.h)
+defines=""
+if [[ -n "$TRACE" ]]; then
+	defines="-DHANDMADE_TRACE"
+fi
+
 if [[ ! -d build ]]; then
 	mkdir -p build;
 fi
 
 pushd build > /dev/null
-gcc -g -std=gnu99 -O3 -lX11 -lXext -lm -ludev -lasound -lpthread -Wall -Wextra -o game ../src/linux_platform.c ../src/platform.c
+# the game is built on its own and swapped in with a rename so a running
+# executable only ever sees a complete game.so when it hot reloads
+gcc -g -std=gnu99 -O3 -fPIC -shared -Wall -Wextra $defines -o game.so.tmp ../src/platform.c ../src/raster.c -lm
+mv game.so.tmp game.so
+# the frame loop and everything it drives, shared by every backend
+engine="../src/engine.c ../src/work_queue.c ../src/oscillator.c ../src/mixer.c ../src/profiler.c ../src/trace.c ../src/frame_pacer.c ../src/input_recording.c ../src/upscale.c ../src/resolution_controller.c ../src/asset_pack.c ../src/sound_stream.c ../src/wav.c"
+# -rdynamic lets game.so resolve the work queue and trace symbols from the executable
+gcc -g -std=gnu99 -O3 -rdynamic -lX11 -lXext -lm -ludev -lasound -lpthread -ldl -Wall -Wextra $defines -o game ../src/linux_platform.c ../src/latency_controller.c ../src/joystick.c $engine
+# the same frame loop with no display, sound card or controllers
+gcc -g -std=gnu99 -O3 -rdynamic -Wall -Wextra $defines -o game_headless ../src/headless_platform.c $engine -lm -lpthread -ldl
+# converts bitmaps and sounds into the pack the engine maps at startup
+gcc -g -std=gnu99 -O2 -Wall -Wextra -o asset_packer ../src/asset_packer.c ../src/asset_pack.c ../src/wav.c
 popd > /dev/null
@@ -8,4 +8,13 @@ fi
 
 pushd build > /dev/null
 gcc -std=gnu99 -g -lpthread -Wall -Wextra -o ring_buffer ../experiments/ring_buffer.c
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o render_gradient ../experiments/render_gradient.c ../src/work_queue.c -lpthread -lm
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o render_benchmark ../experiments/render_benchmark.c ../src/platform.c ../src/work_queue.c -lpthread -lm
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o spsc_ring_buffer ../experiments/spsc_ring_buffer.c -lpthread
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o mirrored_ring_buffer ../experiments/mirrored_ring_buffer.c -lpthread
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o oscillator_benchmark ../experiments/oscillator_benchmark.c -lm
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o mixer_benchmark ../experiments/mixer_benchmark.c ../src/mixer.c ../src/oscillator.c -lm
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o upscale_benchmark ../experiments/upscale_benchmark.c ../src/work_queue.c -lpthread
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o raster_benchmark ../experiments/raster_benchmark.c
+gcc -std=gnu99 -g -O3 -Wall -Wextra -o asset_pack_benchmark ../experiments/asset_pack_benchmark.c ../src/asset_pack.c
 popd > /dev/null
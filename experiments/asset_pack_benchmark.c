@@ -0,0 +1,161 @@
+/*
+ * Compares loading an asset pack by mapping it with reading the whole
+ * file into memory, the way per-file loaders do.
+ *
+ *   ./asset_pack_benchmark [megabytes]
+ *
+ * Writes a pack of 512x512 bitmaps adding up to the given size (256 MB by
+ * default) to benchmark.pack, then for each approach times getting to the
+ * first pixel of one bitmap and reports how much of the file ended up
+ * resident in this process.
+ */
+
+/* standard library */
+#include <stdlib.h> /* malloc, atoi */
+#include <stdio.h> /* printf, fopen */
+#include <string.h> /* strncmp */
+#include <time.h> /* clock_gettime */
+#include <unistd.h> /* unlink */
+
+#include "../src/asset_pack.h"
+
+#define BITMAP_SIZE 512
+
+/* file backed memory this process has resident, from /proc/self/status */
+static long resident_file_kb(void)
+{
+	FILE *status = fopen("/proc/self/status", "r");
+	char line[256];
+	long kb = -1;
+
+	while (status && fgets(line, sizeof(line), status)) {
+		if (!strncmp(line, "RssFile:", 8))
+			kb = atol(line + 8);
+	}
+
+	if (status)
+		fclose(status);
+
+	return kb;
+}
+
+static double now_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e3 + now.tv_nsec * 1e-6;
+}
+
+/* sums one bitmap so every page of it is touched */
+static uint64_t touch_bitmap(const struct offscreen_buffer *bitmap)
+{
+	uint64_t sum = 0;
+
+	for (size_t y = 0; y < bitmap->height; ++y) {
+		const uint32_t *row = (const uint32_t*)((const uint8_t*)bitmap->pixels + y * bitmap->pitch);
+		for (size_t x = 0; x < bitmap->width; ++x)
+			sum += row[x];
+	}
+
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	const int megabytes = argc > 1 ? atoi(argv[1]) : 256;
+	const int bitmap_count = megabytes * (1 << 20) / (BITMAP_SIZE * BITMAP_SIZE * 4);
+	const char *path = "benchmark.pack";
+
+	if (bitmap_count < 1) {
+		fprintf(stderr, "usage: %s [megabytes]\n", argv[0]);
+		return 1;
+	}
+
+	uint32_t *pixels = malloc(BITMAP_SIZE * BITMAP_SIZE * 4);
+	if (!pixels) {
+		fprintf(stderr, "Unable to allocate bitmap\n");
+		return 1;
+	}
+
+	struct asset_pack_writer writer;
+	asset_pack_writer_begin(&writer);
+
+	for (int i = 0; i < bitmap_count; ++i) {
+		char name[ASSET_PACK_NAME_SIZE];
+		snprintf(name, sizeof(name), "bitmap_%04d", i);
+
+		for (int p = 0; p < BITMAP_SIZE * BITMAP_SIZE; ++p)
+			pixels[p] = 0xff000000 | (i * 2654435761u + p);
+
+		if (!asset_pack_add_bitmap(&writer, name, pixels, BITMAP_SIZE, BITMAP_SIZE)) {
+			asset_pack_writer_discard(&writer);
+			return 1;
+		}
+	}
+
+	free(pixels);
+
+	if (!asset_pack_writer_finish(&writer, path))
+		return 1;
+
+	/* one from the middle, well past the index */
+	char middle[ASSET_PACK_NAME_SIZE];
+	snprintf(middle, sizeof(middle), "bitmap_%04d", bitmap_count / 2);
+
+	printf("%d bitmaps, %d MB\n", bitmap_count, megabytes);
+	printf("approach,ms_to_first_bitmap,resident_file_kb,checksum\n");
+
+	/* mapped: only the index and the bitmap touched come in */
+	{
+		const long resident_before = resident_file_kb();
+		const double start = now_ms();
+
+		struct asset_pack pack;
+		if (!asset_pack_open(&pack, path))
+			return 1;
+
+		const struct offscreen_buffer bitmap = asset_pack_bitmap(&pack, middle);
+		const uint64_t sum = touch_bitmap(&bitmap);
+		const double elapsed = now_ms() - start;
+
+		printf("mmap,%.3f,%ld,%llx\n", elapsed, resident_file_kb() - resident_before,
+			(unsigned long long)sum);
+
+		asset_pack_close(&pack);
+	}
+
+	/* read: the whole file is copied in before anything can be used */
+	{
+		const double start = now_ms();
+
+		FILE *file = fopen(path, "rb");
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		uint8_t *bytes = malloc(size);
+		if (!bytes || fread(bytes, 1, size, file) != (size_t)size) {
+			fprintf(stderr, "Unable to read %s\n", path);
+			return 1;
+		}
+		fclose(file);
+
+		struct asset_pack pack = {
+			bytes, size,
+			((const struct asset_pack_header*)bytes)->asset_count,
+			(const struct asset_pack_entry*)(bytes + sizeof(struct asset_pack_header))
+		};
+
+		const struct offscreen_buffer bitmap = asset_pack_bitmap(&pack, middle);
+		const uint64_t sum = touch_bitmap(&bitmap);
+		const double elapsed = now_ms() - start;
+
+		/* anonymous memory, so report the copy itself */
+		printf("read,%.3f,%ld,%llx\n", elapsed, size >> 10, (unsigned long long)sum);
+
+		free(bytes);
+	}
+
+	unlink(path);
+	return 0;
+}
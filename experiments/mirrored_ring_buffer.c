@@ -0,0 +1,283 @@
+/*
+ * Throughput of the lock-free ring in src/ring_buffer.h over flat and
+ * mirrored storage, at the small periods audio is moved in.
+ *
+ *   ./mirrored_ring_buffer [millions of frames] [buffer size]
+ *
+ * Three ways to get past the wrap are compared, each at periods from 8 to
+ * 1024 frames:
+ *
+ *   truncated  stop each batch at the end of the storage, as update_audio did
+ *   split      write and read in two regions, as the audio fill in main() did
+ *   mirrored   one span from the cursor, through the second mapping
+ *
+ * The producer generates an incrementing sequence into the ring and the
+ * consumer copies each batch out, as a device write would, then checks it,
+ * so a lost, duplicated or reordered frame fails the run. Results go to
+ * stdout as CSV, in millions of frames a second.
+ *
+ * Every mode runs on the same pages: truncated and split use the first
+ * mapping of the mirrored ring and never reach into the second. Both
+ * mappings are faulted in before anything is timed, the modes take turns
+ * instead of running back to back, and each cell is the best of REPEATS
+ * runs, so page faults, clock ramps and the scheduler hit them alike.
+ *
+ * Split is the comparison that matters, it is what the fill did before.
+ * Truncated hands the device a short batch at the wrap, which the fill
+ * could not do, and is only there to show what the wrap costs at all.
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+
+/* standard library */
+#include <stdint.h> /* uint32_t */
+#include <stdlib.h> /* atoi, exit */
+#include <stdio.h> /* printf */
+#include <string.h> /* memcpy, memset */
+#include <time.h> /* clock_gettime */
+
+/* external libraries */
+#include <pthread.h>
+#include <sched.h> /* sched_yield, CPU_SET */
+#include <unistd.h> /* sysconf */
+
+#include "../src/ring_buffer.h"
+
+#define MAX_PERIOD 1024
+#define REPEATS 5
+
+enum wrap_mode
+{
+	WRAP_TRUNCATED,
+	WRAP_SPLIT,
+	WRAP_MIRRORED,
+	WRAP_MODE_COUNT
+};
+
+static const char *const mode_names[WRAP_MODE_COUNT] = { "truncated", "split", "mirrored" };
+
+struct benchmark
+{
+	struct ring_buffer buffer;
+	enum wrap_mode mode;
+	uint64_t frame_count;
+	unsigned int period;
+	uint64_t errors;
+};
+
+static inline unsigned int min_uint(unsigned int x, unsigned int y)
+{
+	return x < y ? x : y;
+}
+
+static void pin_to_cpu(int cpu)
+{
+	const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+
+	if (cpu_count < 2)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % cpu_count, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/* writes through the first mapping and reads back through the second, so both have their page tables filled */
+static int warm_mappings(struct ring_buffer *buffer)
+{
+	const size_t bytes = (size_t)buffer->size * buffer->frame_size;
+	volatile uint8_t *data = buffer->data;
+
+	memset(buffer->data, 0xa5, bytes);
+
+	for (size_t i = 0; i < bytes; ++i) {
+		if (data[bytes + i] != 0xa5)
+			return 0;
+	}
+
+	return 1;
+}
+
+static uint32_t generate(uint32_t *frames, unsigned int count, uint32_t sequence)
+{
+	for (unsigned int i = 0; i < count; ++i)
+		frames[i] = sequence++;
+
+	return sequence;
+}
+
+static void *consumer(void *context)
+{
+	struct benchmark *bench = context;
+	struct ring_buffer *buffer = &bench->buffer;
+	uint32_t device[MAX_PERIOD];
+	uint32_t expected = 0;
+	uint64_t remaining = bench->frame_count;
+
+	pin_to_cpu(1);
+
+	while (remaining) {
+		const unsigned int read_cursor = buffer->read_cursor;
+		const unsigned int frames = min_uint(ring_buffer_read_available(buffer), bench->period);
+		const unsigned int frames_to_end = buffer->size - read_cursor;
+		unsigned int read = frames;
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		switch (bench->mode) {
+			case WRAP_TRUNCATED:
+				read = min_uint(frames, frames_to_end);
+				memcpy(device, ring_buffer_frame(buffer, read_cursor), read * sizeof(uint32_t));
+				break;
+
+			case WRAP_SPLIT: {
+				const unsigned int region_one = min_uint(frames, frames_to_end);
+				memcpy(device, ring_buffer_frame(buffer, read_cursor), region_one * sizeof(uint32_t));
+				memcpy(device + region_one, ring_buffer_frame(buffer, 0), (frames - region_one) * sizeof(uint32_t));
+				break;
+			}
+
+			default:
+				memcpy(device, ring_buffer_frame(buffer, read_cursor), frames * sizeof(uint32_t));
+				break;
+		}
+
+		ring_buffer_commit_read(buffer, read);
+		remaining -= read;
+
+		for (unsigned int i = 0; i < read; ++i) {
+			if (device[i] != expected++) {
+				++bench->errors;
+				expected = device[i] + 1;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void producer(struct benchmark *bench)
+{
+	struct ring_buffer *buffer = &bench->buffer;
+	uint32_t sequence = 0;
+	uint64_t remaining = bench->frame_count;
+
+	while (remaining) {
+		const unsigned int write_cursor = buffer->write_cursor;
+		const unsigned int frames_to_end = buffer->size - write_cursor;
+
+		unsigned int frames = min_uint(ring_buffer_write_available(buffer), bench->period);
+		frames = min_uint(frames, remaining);
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		switch (bench->mode) {
+			case WRAP_TRUNCATED:
+				frames = min_uint(frames, frames_to_end);
+				sequence = generate(ring_buffer_frame(buffer, write_cursor), frames, sequence);
+				break;
+
+			case WRAP_SPLIT: {
+				const unsigned int region_one = min_uint(frames, frames_to_end);
+				sequence = generate(ring_buffer_frame(buffer, write_cursor), region_one, sequence);
+				sequence = generate(ring_buffer_frame(buffer, 0), frames - region_one, sequence);
+				break;
+			}
+
+			default:
+				sequence = generate(ring_buffer_frame(buffer, write_cursor), frames, sequence);
+				break;
+		}
+
+		ring_buffer_commit_write(buffer, frames);
+		remaining -= frames;
+	}
+}
+
+static double run(struct benchmark *bench, enum wrap_mode mode, unsigned int period)
+{
+	pthread_t consumer_thread;
+	struct timespec t_start, t_end;
+
+	bench->mode = mode;
+	bench->period = period;
+	ring_buffer_init(&bench->buffer, bench->buffer.data, bench->buffer.size, bench->buffer.frame_size);
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	if (pthread_create(&consumer_thread, NULL, consumer, bench)) {
+		fprintf(stderr, "Unable to create consumer thread\n");
+		exit(1);
+	}
+
+	producer(bench);
+	pthread_join(consumer_thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	return bench->frame_count / elapsed_seconds(&t_start, &t_end) * 1e-6;
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int millions = argc > 1 ? atoi(argv[1]) : 20;
+	const unsigned int buffer_size = argc > 2 ? atoi(argv[2]) : 4800;
+
+	static struct benchmark bench;
+	bench.frame_count = (uint64_t)millions * 1000000;
+
+	/* rounds up to whole pages, every mode shares it */
+	if (!ring_buffer_init_mirrored(&bench.buffer, buffer_size, sizeof(uint32_t))) {
+		fprintf(stderr, "Unable to map a mirrored ring\n");
+		return 1;
+	}
+
+	if (!warm_mappings(&bench.buffer)) {
+		fprintf(stderr, "The second mapping doesn't mirror the first\n");
+		return 1;
+	}
+
+	fprintf(stderr, "%u million frames, buffer of %u, best of %d\n", millions, bench.buffer.size, REPEATS);
+	fprintf(stderr, "split is the baseline, truncated can't hand the device a whole period at the wrap\n");
+	printf("period");
+	for (int mode = 0; mode < WRAP_MODE_COUNT; ++mode)
+		printf(",%s", mode_names[mode]);
+	printf("\n");
+
+	pin_to_cpu(0);
+
+	for (unsigned int period = 8; period <= MAX_PERIOD; period *= 2) {
+		double best[WRAP_MODE_COUNT] = {0};
+
+		for (int repeat = 0; repeat < REPEATS; ++repeat) {
+			for (int mode = 0; mode < WRAP_MODE_COUNT; ++mode) {
+				const double rate = run(&bench, mode, period);
+				if (rate > best[mode])
+					best[mode] = rate;
+			}
+		}
+
+		printf("%u", period);
+		for (int mode = 0; mode < WRAP_MODE_COUNT; ++mode)
+			printf(",%.2f", best[mode]);
+		printf("\n");
+		fflush(stdout);
+	}
+
+	ring_buffer_destroy_mirrored(&bench.buffer);
+
+	if (bench.errors)
+		fprintf(stderr, "%llu frames out of sequence\n", (unsigned long long)bench.errors);
+
+	return bench.errors != 0;
+}
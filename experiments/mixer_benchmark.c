@@ -0,0 +1,128 @@
+/*
+ * Mixing cost of src/mixer.c as the voice count grows.
+ *
+ *   ./mixer_benchmark [frames per call] [calls]
+ *
+ * Half the voices are tones gliding between pitches and half play a looped
+ * buffer, panned across the stereo field. Reports ns per output frame and
+ * per voice-frame; the second should stay flat as voices are added.
+ */
+
+/* standard library */
+#include <math.h> /* sinf */
+#include <stdint.h> /* int16_t */
+#include <stdlib.h> /* malloc, atoi */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+
+#include "../src/mixer.h"
+
+#define SAMPLE_RATE 48000
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+/* every voice at full volume must clip to full scale, not wrap */
+static int check_saturation(struct memory_arena *arena, const float *loop, unsigned int loop_length)
+{
+	struct mixer mixer;
+	int16_t frames[2 * 64];
+
+	const size_t arena_marker = memory_arena_mark(arena);
+	if (!mixer_init(&mixer, arena, SAMPLE_RATE, 8, 64))
+		return 0;
+
+	for (int i = 0; i < 8; ++i)
+		mixer_play_samples(&mixer, loop, loop_length, 1, 1.0f, 0.0f);
+
+	mixer_mix(&mixer, frames, 64);
+
+	int ok = 1;
+	for (int i = 0; i < 64; ++i) {
+		const float expected = loop[i % loop_length] * 8.0f;
+		if (expected >= 1.0f && (frames[2 * i] != 32767 || frames[2 * i + 1] != 32767))
+			ok = 0;
+		if (expected <= -1.0f && (frames[2 * i] != -32768 || frames[2 * i + 1] != -32768))
+			ok = 0;
+	}
+
+	memory_arena_pop(arena, arena_marker);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int frames_per_call = argc > 1 ? atoi(argv[1]) : 800;
+	const unsigned int calls = argc > 2 ? atoi(argv[2]) : 200;
+
+	static const unsigned int voice_counts[] = { 1, 8, 32, 128, 256, 512 };
+	const int count = sizeof(voice_counts) / sizeof(voice_counts[0]);
+
+	const unsigned int loop_length = 4801;
+	float *loop = malloc(loop_length * sizeof(float));
+	int16_t *frames = malloc(2 * frames_per_call * sizeof(int16_t));
+
+	/* each voice count gets the mixer to itself, popped before the next */
+	const size_t storage_size = 4 * 1024 * 1024;
+	void *storage = malloc(storage_size);
+	struct memory_arena arena;
+	memory_arena_init(&arena, storage, storage_size);
+
+	if (!loop || !frames || !storage || !frames_per_call || !calls) {
+		fprintf(stderr, "usage: %s [frames per call] [calls]\n", argv[0]);
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < loop_length; ++i)
+		loop[i] = sinf(i * 0.05f) * 0.5f;
+
+	if (!check_saturation(&arena, loop, loop_length)) {
+		fprintf(stderr, "mixer output wrapped instead of saturating\n");
+		return 1;
+	}
+
+	printf("voices,frames,ns_per_frame,ns_per_voice_frame\n");
+
+	for (int c = 0; c < count; ++c) {
+		const unsigned int voices = voice_counts[c];
+		struct mixer mixer;
+		mixer_voice_handle *handles = malloc(voices * sizeof(mixer_voice_handle));
+
+		if (!handles || !mixer_init(&mixer, &arena, SAMPLE_RATE, voices, 256))
+			return 1;
+
+		const float volume = 1.0f / voices;
+		for (unsigned int v = 0; v < voices; ++v) {
+			const float pan = voices > 1 ? -1.0f + 2.0f * v / (voices - 1) : 0.0f;
+			handles[v] = v % 2
+				? mixer_play_samples(&mixer, loop, loop_length, 1, volume, pan)
+				: mixer_play_tone(&mixer, 220.0f + v, volume, pan);
+		}
+
+		struct timespec t_start, t_end;
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+		for (unsigned int call = 0; call < calls; ++call) {
+			for (unsigned int v = 0; v < voices; v += 2)
+				mixer_set_frequency(&mixer, handles[v], 220.0f + v + (call % 7) * 10.0f, frames_per_call);
+			mixer_mix(&mixer, frames, frames_per_call);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+		const double total_frames = (double)frames_per_call * calls;
+		const double ns = elapsed_ns(&t_start, &t_end);
+
+		printf("%u,%.0f,%.2f,%.3f\n", voices, total_frames, ns / total_frames, ns / (total_frames * voices));
+
+		memory_arena_reset(&arena);
+		free(handles);
+	}
+
+	free(storage);
+	free(loop);
+	free(frames);
+	return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Cycles per sample of the oscillator in src/oscillator.c against the
+ * per-sample sinf loop the main loop used to run.
+ *
+ *   ./oscillator_benchmark [block size] [blocks]
+ *
+ * Every variant writes the same stereo S16 frames the audio ring takes, and
+ * glides the frequency across each block like the main loop does.
+ */
+
+/* standard library */
+#include <math.h> /* sinf, M_PI */
+#include <stdint.h> /* int16_t */
+#include <stdlib.h> /* malloc, atoi */
+#include <stdio.h> /* printf */
+
+#include <x86intrin.h> /* __rdtsc */
+
+/* pull in the kernels directly so every variant can be timed */
+#include "../src/oscillator.c"
+
+#define SAMPLE_RATE 48000
+#define VOLUME 6000
+
+static float next_hz(unsigned int block)
+{
+	/* wobble around middle c like a stick being moved */
+	return 261.0f + 65.0f * sinf(block * 0.01f);
+}
+
+static void reference_loop(int16_t *frames, unsigned int block_size, unsigned int blocks)
+{
+	static double t = 0;
+	float previous_tone_hz = 0;
+
+	for (unsigned int block = 0; block < blocks; ++block) {
+		const float tone_hz = next_hz(block);
+		const float tone_step = (tone_hz - previous_tone_hz) / block_size;
+		float curr_hz = previous_tone_hz;
+		int16_t *sample_ptr = frames;
+
+		for (unsigned int i = 0; i < block_size; ++i) {
+			const double wave_period = SAMPLE_RATE / curr_hz;
+			const int16_t value = sinf(t) * VOLUME;
+			*sample_ptr++ = value;
+			*sample_ptr++ = value;
+			t += (2.0f * M_PI) / wave_period;
+			curr_hz += tone_step;
+		}
+
+		previous_tone_hz = tone_hz;
+	}
+}
+
+static void oscillator_loop(
+	oscillator_fill_fn *fill, float *samples, int16_t *frames,
+	unsigned int block_size, unsigned int blocks)
+{
+	struct oscillator tone;
+	oscillator_init(&tone, SAMPLE_RATE, 0);
+
+	for (unsigned int block = 0; block < blocks; ++block) {
+		const float tone_hz = next_hz(block);
+		int16_t *sample_ptr = frames;
+
+		fill(&tone, samples, block_size, (tone_hz - tone.hz) / block_size);
+		tone.hz = tone_hz;
+
+		for (unsigned int i = 0; i < block_size; ++i) {
+			const int16_t value = samples[i] * VOLUME;
+			*sample_ptr++ = value;
+			*sample_ptr++ = value;
+		}
+	}
+}
+
+/* largest difference from sinf over a few thousand periods at fixed pitch */
+static float max_error(oscillator_fill_fn *fill, float *samples, unsigned int count)
+{
+	struct oscillator tone;
+	oscillator_init(&tone, SAMPLE_RATE, 440.0f);
+
+	fill(&tone, samples, count, 0.0f);
+
+	float error = 0.0f;
+	double phase = 0.0;
+	for (unsigned int i = 0; i < count; ++i) {
+		const float diff = fabsf(samples[i] - sinf(2.0 * M_PI * phase));
+		if (diff > error)
+			error = diff;
+		phase += 440.0 / SAMPLE_RATE;
+		phase -= floor(phase);
+	}
+
+	return error;
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int block_size = argc > 1 ? atoi(argv[1]) : 800;
+	const unsigned int blocks = argc > 2 ? atoi(argv[2]) : 2000;
+	const double samples_total = (double)block_size * blocks;
+
+	float *samples = malloc(SAMPLE_RATE * sizeof(float));
+	int16_t *frames = malloc(block_size * 2 * sizeof(int16_t));
+
+	if (!samples || !frames || !block_size || block_size > SAMPLE_RATE) {
+		fprintf(stderr, "usage: %s [block size <= %d] [blocks]\n", argv[0], SAMPLE_RATE);
+		return 1;
+	}
+
+	struct {
+		const char *name;
+		oscillator_fill_fn *fill;
+		int supported;
+	} variants[] = {
+		{ "scalar", oscillator_fill_scalar, 1 },
+#ifdef HANDMADE_X86
+		{ "sse2", oscillator_fill_sse2, __builtin_cpu_supports("sse2") },
+		{ "avx2", oscillator_fill_avx2, __builtin_cpu_supports("avx2") },
+#endif
+	};
+	const int variant_count = sizeof(variants) / sizeof(variants[0]);
+
+	printf("%u blocks of %u samples\n", blocks, block_size);
+
+	uint64_t start = __rdtsc();
+	reference_loop(frames, block_size, blocks);
+	const double reference_cycles = (__rdtsc() - start) / samples_total;
+
+	printf("%-10s %7.2f cycles/sample\n", "sinf", reference_cycles);
+
+	for (int v = 0; v < variant_count; ++v) {
+		if (!variants[v].supported)
+			continue;
+
+		start = __rdtsc();
+		oscillator_loop(variants[v].fill, samples, frames, block_size, blocks);
+		const double cycles = (__rdtsc() - start) / samples_total;
+
+		printf("%-10s %7.2f cycles/sample (%4.1fx) max error %.5f\n",
+			variants[v].name, cycles, reference_cycles / cycles,
+			max_error(variants[v].fill, samples, SAMPLE_RATE));
+	}
+
+	free(samples);
+	free(frames);
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Checks the SIMD raster kernels in src/raster.c against the scalar ones
+ * and measures fill and blend rates in pixels per second.
+ *
+ *   ./raster_benchmark [iterations]
+ *
+ * Every case draws into a 1280x720 buffer: full screen rectangles, and
+ * 64x64 sprites scattered over it, half of them hanging off an edge.
+ */
+
+/* standard library */
+#include <stdlib.h> /* malloc, atoi, rand */
+#include <string.h> /* memcmp, memset */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+
+/* pull in the kernels directly so the variants can be forced */
+#include "../src/raster.c"
+#include "test_buffers.h"
+
+struct kernels
+{
+	const char *name;
+	raster_fill_fn *fill;
+	raster_blend_fn *blend;
+	raster_blend_color_fn *blend_color;
+};
+
+static const struct kernels scalar = {
+	"scalar", raster_fill_scalar, raster_blend_scalar, raster_blend_color_scalar
+};
+
+static void use_kernels(const struct kernels *kernels)
+{
+	raster_fill = kernels->fill;
+	raster_blend = kernels->blend;
+	raster_blend_color = kernels->blend_color;
+}
+
+/* premultiplied pixels with runs of opaque and transparent ones, like a sprite */
+static void fill_sprite(struct offscreen_buffer *bitmap)
+{
+	for (size_t y = 0; y < bitmap->height; ++y) {
+		uint32_t *row = buffer_row(bitmap, 0, y);
+
+		for (size_t x = 0; x < bitmap->width; ++x) {
+			const int kind = ((x / 8) + (y / 8)) % 3;
+			const uint8_t alpha = kind == 0 ? 0 : kind == 1 ? 255 : rand();
+
+			row[x] = raster_color(alpha, rand(), rand(), rand());
+		}
+	}
+}
+
+static int compare_buffers(const struct offscreen_buffer *a, const struct offscreen_buffer *b)
+{
+	return !memcmp(a->pixels, b->pixels, a->pitch * a->height);
+}
+
+/* draws the same thing with both kernel sets and compares the whole buffer, padding too */
+static int compare(const struct kernels *kernels, size_t width, size_t height, int x, int y)
+{
+	struct offscreen_buffer expected = make_buffer(40, 24, 12);
+	struct offscreen_buffer bitmap = make_buffer(width, height, 8);
+	int same = 1;
+
+	fill_random(&expected);
+	fill_sprite(&bitmap);
+
+	struct offscreen_buffer actual = make_buffer(40, 24, 12);
+	const uint32_t color = raster_color(rand(), rand(), rand(), rand());
+
+	for (int operation = 0; operation < 4; ++operation) {
+		memcpy(actual.pixels, expected.pixels, expected.pitch * expected.height);
+
+		for (int pass = 0; pass < 2; ++pass) {
+			struct offscreen_buffer *buffer = pass ? &actual : &expected;
+			use_kernels(pass ? kernels : &scalar);
+
+			switch (operation) {
+				case 0: raster_fill_rect(buffer, x, y, width, height, color); break;
+				case 1: raster_blend_rect(buffer, x, y, width, height, color); break;
+				case 2: raster_blit(buffer, &bitmap, x, y); break;
+				case 3: raster_blit_blend(buffer, &bitmap, x, y); break;
+			}
+		}
+
+		if (!compare_buffers(&expected, &actual)) {
+			fprintf(stderr, "%s: operation %d mismatch drawing %zux%zu at %d,%d\n",
+				kernels->name, operation, width, height, x, y);
+			same = 0;
+		}
+	}
+
+	free(expected.pixels);
+	free(actual.pixels);
+	free(bitmap.pixels);
+
+	return same;
+}
+
+enum benchmark_case
+{
+	FILL_SCREEN,
+	BLEND_SCREEN,
+	BLIT_SPRITES,
+	BLEND_SPRITES,
+	CASE_COUNT
+};
+
+static const char *case_names[CASE_COUNT] = {
+	"fill_rect_1280x720", "blend_rect_1280x720", "blit_64x64", "blit_blend_64x64"
+};
+
+#define SPRITE_COUNT 256
+
+/* pixels per second drawing the case iterations times */
+static double time_case(enum benchmark_case which, int iterations)
+{
+	struct offscreen_buffer buffer = make_buffer(1280, 720, 0);
+	struct offscreen_buffer sprite = make_buffer(64, 64, 0);
+	struct timespec t_start, t_end;
+	int positions[SPRITE_COUNT][2];
+	double pixels = 1280 * 720;
+
+	fill_random(&buffer);
+	fill_sprite(&sprite);
+
+	for (int i = 0; i < SPRITE_COUNT; ++i) {
+		positions[i][0] = rand() % (1280 + 64) - 32;
+		positions[i][1] = rand() % (720 + 64) - 32;
+	}
+
+	const uint32_t color = raster_color(160, 40, 120, 200);
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (int i = 0; i < iterations; ++i) {
+		buffer.dirty_count = 0;
+
+		switch (which) {
+			case FILL_SCREEN:
+				raster_fill_rect(&buffer, 0, 0, 1280, 720, color | 0xff000000);
+				break;
+			case BLEND_SCREEN:
+				raster_blend_rect(&buffer, 0, 0, 1280, 720, color);
+				break;
+			case BLIT_SPRITES:
+				for (int s = 0; s < SPRITE_COUNT; ++s)
+					raster_blit(&buffer, &sprite, positions[s][0], positions[s][1]);
+				break;
+			case BLEND_SPRITES:
+				for (int s = 0; s < SPRITE_COUNT; ++s)
+					raster_blit_blend(&buffer, &sprite, positions[s][0], positions[s][1]);
+				break;
+			case CASE_COUNT:
+				break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	/* sprites only count the pixels left after clipping */
+	if (which == BLIT_SPRITES || which == BLEND_SPRITES) {
+		pixels = 0;
+		for (int s = 0; s < SPRITE_COUNT; ++s) {
+			struct dirty_rect rect = { positions[s][0], positions[s][1], 64, 64 };
+			int skip_x, skip_y;
+			if (clip(&buffer, &rect, &skip_x, &skip_y))
+				pixels += (double)rect.width * rect.height;
+		}
+	}
+
+	free(buffer.pixels);
+	free(sprite.pixels);
+
+	const double elapsed = (t_end.tv_sec - t_start.tv_sec)
+		+ (t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+
+	return pixels * iterations / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	const int iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+	if (iterations < 1) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	/* fills in the selected kernels */
+	select_raster_kernels();
+	const struct kernels selected = { "selected", raster_fill, raster_blend, raster_blend_color };
+
+	int failures = 0;
+	int checks = 0;
+
+	/* every vector tail, clipped on each side and not at all */
+	for (size_t width = 1; width <= 37; width += 3) {
+		for (size_t height = 1; height <= 9; height += 4) {
+			static const int offsets[][2] = {
+				{ 0, 0 }, { 3, 5 }, { -5, -2 }, { 30, 20 }, { -2, 18 }, { 39, 23 }, { 40, 0 },
+			};
+
+			for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o) {
+				failures += !compare(&selected, width, height, offsets[o][0], offsets[o][1]);
+				++checks;
+			}
+		}
+	}
+
+	printf("%d comparisons of 4 operations against scalar\n", checks);
+	printf("case,scalar_mpixels_per_s,selected_mpixels_per_s,speedup\n");
+
+	for (int c = 0; c < CASE_COUNT; ++c) {
+		use_kernels(&scalar);
+		const double scalar_rate = time_case(c, iterations);
+
+		use_kernels(&selected);
+		const double selected_rate = time_case(c, iterations);
+
+		printf("%s,%.1f,%.1f,%.2f\n", case_names[c],
+			scalar_rate * 1e-6, selected_rate * 1e-6, selected_rate / scalar_rate);
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d comparisons failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Headless benchmark for game_render(). Steps and renders the game into plain
+ * memory at a few resolutions and pitches and prints one CSV row per
+ * configuration:
+ *
+ *   ./render_benchmark [frames] [warmup]
+ *
+ * The render thread count follows HANDMADE_RENDER_THREADS like the game does.
+ */
+
+/* standard library */
+#include <assert.h> /* assert */
+#include <stdlib.h> /* posix_memalign, atoi, qsort */
+#include <string.h> /* memset */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+#include <unistd.h> /* sysconf */
+
+#include "../src/platform.h"
+
+struct configuration
+{
+	const char *name;
+	size_t width;
+	size_t height;
+	size_t pitch_padding; /* bytes added to the end of every row */
+};
+
+static long elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000000L + (end->tv_nsec - start->tv_nsec);
+}
+
+static int compare_long(const void *a, const void *b)
+{
+	const long lhs = *(const long*)a;
+	const long rhs = *(const long*)b;
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/* nearest-rank percentile of a sorted array */
+static long percentile(const long *sorted, int count, int percent)
+{
+	int rank = (count * percent + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+	return sorted[rank - 1];
+}
+
+static struct work_queue *create_render_queue(struct memory_arena *arena)
+{
+	const char *threads = getenv("HANDMADE_RENDER_THREADS");
+	long thread_count = threads ? atoi(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (thread_count < 1)
+		thread_count = 1;
+
+	return work_queue_create(arena, thread_count - 1);
+}
+
+/* scrolls diagonally like a stick held down */
+static void step_game(struct game_memory *memory, struct offscreen_buffer *buffer)
+{
+	static const struct game_input input = { .controllers[0] = { 1, -0.6f, 0.4f } };
+
+	buffer->dirty_count = 0;
+	game_update(memory, &input, 1.0f / 60.0f);
+	game_render(memory, buffer, 1.0f);
+	memory_arena_reset(&memory->transient);
+}
+
+static void run_configuration(
+	struct game_memory *memory, const struct configuration *config,
+	int frames, int warmup, long *frame_times)
+{
+	const size_t pitch = config->width * 4 + config->pitch_padding;
+	const size_t size = pitch * config->height;
+
+	struct offscreen_buffer buffer;
+	buffer.width = config->width;
+	buffer.height = config->height;
+	buffer.pitch = pitch;
+
+	if (posix_memalign(&buffer.pixels, 64, size)) {
+		fprintf(stderr, "Unable to allocate %zu byte buffer\n", size);
+		exit(1);
+	}
+
+	memset(buffer.pixels, 0, size);
+
+	for (int i = 0; i < warmup; ++i)
+		step_game(memory, &buffer);
+
+	long total = 0;
+	for (int i = 0; i < frames; ++i) {
+		struct timespec t_start, t_end;
+
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		step_game(memory, &buffer);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+		frame_times[i] = elapsed_ns(&t_start, &t_end);
+		total += frame_times[i];
+	}
+
+	free(buffer.pixels);
+
+	qsort(frame_times, frames, sizeof(long), compare_long);
+
+	const double pixels = (double)config->width * config->height;
+	const double mean_ns = (double)total / frames;
+
+	printf("%s,%zu,%zu,%zu,%d,%.4f,%.3f,%.1f,%ld,%ld,%ld\n",
+		config->name,
+		config->width,
+		config->height,
+		pitch,
+		frames,
+		mean_ns / pixels,
+		(pixels * 4) / mean_ns, /* bytes per ns == GB/s */
+		mean_ns,
+		percentile(frame_times, frames, 50),
+		percentile(frame_times, frames, 99),
+		frame_times[frames - 1]);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	const int frames = argc > 1 ? atoi(argv[1]) : 200;
+	const int warmup = argc > 2 ? atoi(argv[2]) : 10;
+
+	static const struct configuration configs[] = {
+		{ "720p",        1280,  720,   0 },
+		{ "720p-padded", 1280,  720,  64 },
+		{ "1080p",       1920, 1080,   0 },
+		{ "1080p-odd",   1918, 1080,  24 },
+		{ "1440p",       2560, 1440,   0 },
+		{ "4k",          3840, 2160,   0 },
+		{ "4k-padded",   3840, 2160, 256 },
+	};
+	const int config_count = sizeof(configs) / sizeof(configs[0]);
+
+	if (frames < 1 || warmup < 0) {
+		fprintf(stderr, "usage: %s [frames] [warmup]\n", argv[0]);
+		return 1;
+	}
+
+	long *frame_times = malloc(frames * sizeof(long));
+	assert(frame_times);
+
+	const size_t storage_size = 1024 * 1024;
+	void *storage = calloc(3, storage_size);
+
+	/* the third block stands in for the platform's arena */
+	struct memory_arena platform_arena;
+	struct game_memory memory;
+	memory_arena_init(&memory.permanent, storage, storage_size);
+	memory_arena_init(&memory.transient, (char*)storage + storage_size, storage_size);
+	memory_arena_init(&platform_arena, (char*)storage + 2 * storage_size, storage_size);
+	memory.platform.run_work = work_queue_run;
+	memory.platform.render_queue = create_render_queue(&platform_arena);
+
+	if (!storage || !memory.platform.render_queue) {
+		fprintf(stderr, "Unable to set up game memory\n");
+		return 1;
+	}
+
+	printf("config,width,height,pitch,frames,ns_per_pixel,gb_per_s,mean_ns,p50_ns,p99_ns,max_ns\n");
+
+	for (int i = 0; i < config_count; ++i)
+		run_configuration(&memory, &configs[i], frames, warmup, frame_times);
+
+	work_queue_destroy(memory.platform.render_queue);
+	free(storage);
+	free(frame_times);
+	return 0;
+}
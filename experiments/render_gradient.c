@@ -0,0 +1,160 @@
+/* standard library */
+#include <assert.h> /* assert */
+#include <stdlib.h> /* malloc, atoi */
+#include <string.h> /* memset */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+
+/* pull in the kernels directly so the static variants can be compared */
+#include "../src/platform.c"
+
+struct kernel
+{
+	const char *name;
+	render_gradient_fn *fn;
+	int supported;
+};
+
+/* buffers are pre-filled so a kernel writing into the row padding shows up */
+#define GUARD 0xa5
+
+static void fill_buffer(struct offscreen_buffer *buffer, size_t size)
+{
+	memset(buffer->pixels, GUARD, size);
+}
+
+static int compare_kernels(
+	const struct kernel *reference, const struct kernel *kernel,
+	size_t width, size_t height, size_t pitch, int xoffset, int yoffset)
+{
+	const size_t size = pitch * height;
+	struct offscreen_buffer expected = {
+		.pixels = malloc(size), .width = width, .height = height, .pitch = pitch };
+	struct offscreen_buffer actual = {
+		.pixels = malloc(size), .width = width, .height = height, .pitch = pitch };
+
+	assert(expected.pixels && actual.pixels);
+
+	fill_buffer(&expected, size);
+	fill_buffer(&actual, size);
+
+	reference->fn(&expected, xoffset, yoffset);
+	kernel->fn(&actual, xoffset, yoffset);
+
+	int mismatches = 0;
+	for (size_t y = 0; y < height; ++y) {
+		const uint8_t *expected_row = (uint8_t*)expected.pixels + y * pitch;
+		const uint8_t *actual_row = (uint8_t*)actual.pixels + y * pitch;
+
+		/* compare the padding too, it must be left untouched */
+		for (size_t x = 0; x < pitch; ++x) {
+			if (expected_row[x] != actual_row[x]) {
+				if (!mismatches++) {
+					fprintf(stderr,
+						"%s: mismatch at byte %zu of row %zu "
+						"(%zux%zu pitch %zu offset %d,%d)\n",
+						kernel->name, x, y, width, height, pitch, xoffset, yoffset);
+				}
+			}
+		}
+	}
+
+	free(expected.pixels);
+	free(actual.pixels);
+
+	return mismatches == 0;
+}
+
+static double time_kernel(
+	const struct kernel *kernel, size_t width, size_t height, int iterations)
+{
+	struct offscreen_buffer buffer = {
+		.pixels = malloc(width * height * 4), .width = width, .height = height, .pitch = width * 4 };
+	struct timespec t_start, t_end;
+
+	assert(buffer.pixels);
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (int i = 0; i < iterations; ++i) {
+		kernel->fn(&buffer, i, -i);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	free(buffer.pixels);
+
+	const double elapsed = (t_end.tv_sec - t_start.tv_sec) * 1e9
+		+ (t_end.tv_nsec - t_start.tv_nsec);
+
+	return elapsed / ((double)iterations * width * height);
+}
+
+int main(int argc, char **argv)
+{
+	const int iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+	__builtin_cpu_init();
+
+	struct kernel kernels[] = {
+		{ "scalar", render_gradient_scalar, 1 },
+#ifdef HANDMADE_X86
+		{ "sse2", render_gradient_sse2, __builtin_cpu_supports("sse2") },
+		{ "avx2", render_gradient_avx2, __builtin_cpu_supports("avx2") },
+#endif
+	};
+	const int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+	static const int offsets[][2] = {
+		{ 0, 0 }, { 1, -1 }, { -300, 77 }, { 255, 256 }, { 100000, -100000 },
+	};
+	const int offset_count = sizeof(offsets) / sizeof(offsets[0]);
+
+	int failures = 0;
+
+	for (int k = 1; k < kernel_count; ++k) {
+		if (!kernels[k].supported) {
+			printf("%-8s unsupported, skipped\n", kernels[k].name);
+			continue;
+		}
+
+		int checks = 0;
+
+		/* every row tail length for each vector width, tight and padded pitches */
+		for (size_t width = 1; width <= 67; ++width) {
+			for (size_t padding = 0; padding <= 12; padding += 4) {
+				for (int o = 0; o < offset_count; ++o) {
+					failures += !compare_kernels(
+						&kernels[0], &kernels[k],
+						width, 5, width * 4 + padding,
+						offsets[o][0], offsets[o][1]);
+					++checks;
+				}
+			}
+		}
+
+		failures += !compare_kernels(&kernels[0], &kernels[k], 1280, 720, 1280 * 4, 13, 7);
+		failures += !compare_kernels(&kernels[0], &kernels[k], 1920, 1080, 2048 * 4, -5, 3);
+		checks += 2;
+
+		printf("%-8s %d comparisons against scalar\n", kernels[k].name, checks);
+	}
+
+	for (int k = 0; k < kernel_count; ++k) {
+		if (kernels[k].supported) {
+			printf("%-8s %6.3f ns/pixel at 1280x720\n", kernels[k].name,
+				time_kernel(&kernels[k], 1280, 720, iterations));
+		}
+	}
+
+	render_gradient_fn *const selected = select_render_gradient();
+	for (int k = 0; k < kernel_count; ++k) {
+		if (kernels[k].fn == selected)
+			printf("selected kernel: %s\n", kernels[k].name);
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d comparisons failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,282 @@
+/*
+ * Stress test and throughput comparison for the lock-free ring buffer in
+ * src/ring_buffer.h against a mutex protected ring in the style of
+ * experiments/ring_buffer.c.
+ *
+ *   ./spsc_ring_buffer [millions of frames] [chunk size] [buffer size]
+ *
+ * Producer and consumer run flat out on different cores (when there are
+ * two). The producer writes an incrementing sequence and the consumer checks
+ * every frame it reads, so a lost, duplicated or reordered frame fails the
+ * run.
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+
+/* standard library */
+#include <assert.h> /* assert */
+#include <stdint.h> /* uint32_t */
+#include <stdlib.h> /* malloc, atoi, exit */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+
+/* external libraries */
+#include <pthread.h>
+#include <sched.h> /* sched_yield, CPU_SET */
+#include <unistd.h> /* sysconf */
+
+#include "../src/ring_buffer.h"
+
+#define MIN(x, y) (x) < (y) ? (x) : (y)
+
+struct mutex_ring_buffer
+{
+	unsigned int read_cursor;
+	unsigned int write_cursor;
+	unsigned int size;
+	pthread_mutex_t mutex;
+	uint32_t *data;
+};
+
+struct benchmark
+{
+	struct ring_buffer spsc;
+	struct mutex_ring_buffer locked;
+	uint64_t frame_count;
+	unsigned int chunk_size;
+	uint64_t errors;
+};
+
+static void pin_to_cpu(int cpu)
+{
+	const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+
+	if (cpu_count < 2)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % cpu_count, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/*
+ * lock-free ring
+ */
+
+static void *spsc_consumer(void *context)
+{
+	struct benchmark *bench = context;
+	struct ring_buffer *buffer = &bench->spsc;
+	uint32_t expected = 0;
+	uint64_t remaining = bench->frame_count;
+
+	pin_to_cpu(1);
+
+	while (remaining) {
+		const unsigned int read_cursor = buffer->read_cursor;
+		const unsigned int available = ring_buffer_read_available(buffer);
+		const unsigned int frames_to_end = buffer->size - read_cursor;
+
+		unsigned int frames = MIN(available, bench->chunk_size);
+		frames = MIN(frames, frames_to_end);
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		const uint32_t *frame = ring_buffer_frame(buffer, read_cursor);
+		for (unsigned int i = 0; i < frames; ++i) {
+			if (frame[i] != expected++) {
+				++bench->errors;
+				expected = frame[i] + 1;
+			}
+		}
+
+		ring_buffer_commit_read(buffer, frames);
+		remaining -= frames;
+	}
+
+	return NULL;
+}
+
+static void spsc_producer(struct benchmark *bench)
+{
+	struct ring_buffer *buffer = &bench->spsc;
+	uint32_t sequence = 0;
+	uint64_t remaining = bench->frame_count;
+
+	while (remaining) {
+		const unsigned int write_cursor = buffer->write_cursor;
+		const unsigned int available = ring_buffer_write_available(buffer);
+		const unsigned int frames_to_end = buffer->size - write_cursor;
+
+		unsigned int frames = MIN(available, bench->chunk_size);
+		frames = MIN(frames, frames_to_end);
+		frames = MIN(frames, remaining);
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		uint32_t *frame = ring_buffer_frame(buffer, write_cursor);
+		for (unsigned int i = 0; i < frames; ++i)
+			frame[i] = sequence++;
+
+		ring_buffer_commit_write(buffer, frames);
+		remaining -= frames;
+	}
+}
+
+/*
+ * mutex ring, cursors only touched with the lock held
+ */
+
+static void *locked_consumer(void *context)
+{
+	struct benchmark *bench = context;
+	struct mutex_ring_buffer *buffer = &bench->locked;
+	uint32_t expected = 0;
+	uint64_t remaining = bench->frame_count;
+
+	pin_to_cpu(1);
+
+	while (remaining) {
+		pthread_mutex_lock(&buffer->mutex);
+		const unsigned int read_cursor = buffer->read_cursor;
+		const unsigned int write_cursor = buffer->write_cursor;
+		pthread_mutex_unlock(&buffer->mutex);
+
+		const unsigned int available = write_cursor >= read_cursor
+			? write_cursor - read_cursor
+			: buffer->size - read_cursor + write_cursor;
+
+		unsigned int frames = MIN(available, bench->chunk_size);
+		frames = MIN(frames, buffer->size - read_cursor);
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		for (unsigned int i = 0; i < frames; ++i) {
+			const uint32_t value = buffer->data[read_cursor + i];
+			if (value != expected++) {
+				++bench->errors;
+				expected = value + 1;
+			}
+		}
+
+		pthread_mutex_lock(&buffer->mutex);
+		buffer->read_cursor = (read_cursor + frames) % buffer->size;
+		pthread_mutex_unlock(&buffer->mutex);
+
+		remaining -= frames;
+	}
+
+	return NULL;
+}
+
+static void locked_producer(struct benchmark *bench)
+{
+	struct mutex_ring_buffer *buffer = &bench->locked;
+	uint32_t sequence = 0;
+	uint64_t remaining = bench->frame_count;
+
+	while (remaining) {
+		pthread_mutex_lock(&buffer->mutex);
+		const unsigned int read_cursor = buffer->read_cursor;
+		const unsigned int write_cursor = buffer->write_cursor;
+		pthread_mutex_unlock(&buffer->mutex);
+
+		const unsigned int used = write_cursor >= read_cursor
+			? write_cursor - read_cursor
+			: buffer->size - read_cursor + write_cursor;
+
+		unsigned int frames = MIN(buffer->size - 1 - used, bench->chunk_size);
+		frames = MIN(frames, buffer->size - write_cursor);
+		frames = MIN(frames, remaining);
+
+		if (!frames) {
+			sched_yield();
+			continue;
+		}
+
+		for (unsigned int i = 0; i < frames; ++i)
+			buffer->data[write_cursor + i] = sequence++;
+
+		pthread_mutex_lock(&buffer->mutex);
+		buffer->write_cursor = (write_cursor + frames) % buffer->size;
+		pthread_mutex_unlock(&buffer->mutex);
+
+		remaining -= frames;
+	}
+}
+
+static void run(
+	const char *name, struct benchmark *bench,
+	void *(*consumer)(void *), void (*producer)(struct benchmark *))
+{
+	pthread_t consumer_thread;
+	struct timespec t_start, t_end;
+
+	bench->errors = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	if (pthread_create(&consumer_thread, NULL, consumer, bench)) {
+		fprintf(stderr, "Unable to create consumer thread\n");
+		exit(1);
+	}
+
+	producer(bench);
+	pthread_join(consumer_thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	const double seconds = elapsed_seconds(&t_start, &t_end);
+
+	printf("%-8s %8.2f Mframes/s %6.3f s errors: %llu\n",
+		name, bench->frame_count / seconds * 1e-6, seconds,
+		(unsigned long long)bench->errors);
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int millions = argc > 1 ? atoi(argv[1]) : 100;
+	const unsigned int chunk_size = argc > 2 ? atoi(argv[2]) : 256;
+	const unsigned int buffer_size = argc > 3 ? atoi(argv[3]) : 4800;
+
+	static struct benchmark bench;
+	bench.frame_count = (uint64_t)millions * 1000000;
+	bench.chunk_size = chunk_size;
+
+	uint32_t *spsc_data = malloc(buffer_size * sizeof(uint32_t));
+	uint32_t *locked_data = malloc(buffer_size * sizeof(uint32_t));
+	assert(spsc_data && locked_data);
+
+	ring_buffer_init(&bench.spsc, spsc_data, buffer_size, sizeof(uint32_t));
+
+	bench.locked.size = buffer_size;
+	bench.locked.data = locked_data;
+	pthread_mutex_init(&bench.locked.mutex, NULL);
+
+	printf("%u million frames, chunks of %u, buffer of %u\n", millions, chunk_size, buffer_size);
+
+	pin_to_cpu(0);
+
+	run("spsc", &bench, spsc_consumer, spsc_producer);
+	const uint64_t spsc_errors = bench.errors;
+
+	run("mutex", &bench, locked_consumer, locked_producer);
+
+	free(spsc_data);
+	free(locked_data);
+
+	return spsc_errors || bench.errors;
+}
@@ -0,0 +1,38 @@
+#ifndef HANDMADE_TEST_BUFFERS
+#define HANDMADE_TEST_BUFFERS
+
+/* standard library */
+#include <stdint.h> /* uint8_t */
+#include <stdlib.h> /* malloc, exit, rand */
+#include <stdio.h> /* fprintf */
+
+#include "../src/platform.h"
+
+/*
+ * Offscreen buffers for the kernel checks and benchmarks. Padding goes on
+ * the end of every row, so a kernel that writes past its width shows up in
+ * the comparison.
+ */
+
+static struct offscreen_buffer make_buffer(size_t width, size_t height, size_t padding)
+{
+	struct offscreen_buffer buffer = {
+		.width = width, .height = height, .pitch = width * 4 + padding };
+
+	buffer.pixels = malloc(buffer.pitch * height);
+	if (!buffer.pixels) {
+		fprintf(stderr, "Unable to allocate %zux%zu buffer\n", width, height);
+		exit(1);
+	}
+
+	return buffer;
+}
+
+static void fill_random(struct offscreen_buffer *buffer)
+{
+	uint8_t *bytes = buffer->pixels;
+	for (size_t i = 0; i < buffer->pitch * buffer->height; ++i)
+		bytes[i] = rand();
+}
+
+#endif /* HANDMADE_TEST_BUFFERS */
@@ -0,0 +1,240 @@
+/*
+ * Checks the SIMD upscale kernels in src/upscale.c against the scalar ones
+ * and times the blit at the scales dynamic resolution uses.
+ *
+ *   ./upscale_benchmark [iterations]
+ *
+ * The timings run on one thread; HANDMADE_RENDER_THREADS sets how many the
+ * last column uses, like the game.
+ */
+
+/* standard library */
+#include <stdlib.h> /* malloc, atoi, rand */
+#include <string.h> /* memcmp, memset */
+#include <stdio.h> /* printf */
+#include <time.h> /* clock_gettime */
+#include <unistd.h> /* sysconf */
+
+/* pull in the kernels directly so the variants can be forced */
+#include "../src/upscale.c"
+#include "test_buffers.h"
+
+struct kernels
+{
+	const char *name;
+	upscale_nearest_fn *nearest;
+	upscale_blend_fn *blend;
+	upscale_lerp_fn *lerp;
+};
+
+static const struct kernels scalar = {
+	"scalar", upscale_nearest_scalar, upscale_blend_scalar, upscale_lerp_scalar
+};
+
+static void use_kernels(const struct kernels *kernels)
+{
+	upscale_nearest = kernels->nearest;
+	upscale_blend = kernels->blend;
+	upscale_lerp = kernels->lerp;
+}
+
+/* upscales with both kernel sets and compares the whole output, padding too */
+static int compare(
+	struct work_queue *queue, const struct kernels *kernels,
+	size_t from_width, size_t from_height, size_t to_width, size_t to_height,
+	const struct dirty_rect *rect, enum upscale_filter filter)
+{
+	struct offscreen_buffer from = make_buffer(from_width, from_height, 8);
+	struct offscreen_buffer expected = make_buffer(to_width, to_height, 12);
+	struct offscreen_buffer actual = make_buffer(to_width, to_height, 12);
+
+	fill_random(&from);
+	memset(expected.pixels, 0xa5, expected.pitch * to_height);
+	memset(actual.pixels, 0xa5, actual.pitch * to_height);
+
+	use_kernels(&scalar);
+	upscale(queue, &expected, &from, rect, filter);
+
+	use_kernels(kernels);
+	upscale(queue, &actual, &from, rect, filter);
+
+	const int same = !memcmp(expected.pixels, actual.pixels, expected.pitch * to_height);
+
+	if (!same) {
+		fprintf(stderr, "%s %s: mismatch upscaling %zux%zu to %zux%zu (rect %d,%d %dx%d)\n",
+			kernels->name, filter == UPSCALE_NEAREST ? "nearest" : "bilinear",
+			from_width, from_height, to_width, to_height,
+			rect->x, rect->y, rect->width, rect->height);
+	}
+
+	free(from.pixels);
+	free(expected.pixels);
+	free(actual.pixels);
+
+	return same;
+}
+
+/* upscales in strips and in one pass, every pixel has to come out the same */
+static int compare_strips(
+	struct work_queue *queue, size_t from_width, size_t from_height,
+	size_t to_width, size_t to_height, int strip_width, enum upscale_filter filter)
+{
+	struct offscreen_buffer from = make_buffer(from_width, from_height, 8);
+	struct offscreen_buffer whole = make_buffer(to_width, to_height, 12);
+	struct offscreen_buffer strips = make_buffer(to_width, to_height, 12);
+	const struct dirty_rect everything = { 0, 0, to_width, to_height };
+
+	fill_random(&from);
+	memset(whole.pixels, 0xa5, whole.pitch * to_height);
+	memset(strips.pixels, 0xa5, strips.pitch * to_height);
+
+	upscale(queue, &whole, &from, &everything, filter);
+
+	for (int x = 0; x < (int)to_width; x += strip_width) {
+		const int width = x + strip_width < (int)to_width ? strip_width : (int)to_width - x;
+		upscale(queue, &strips, &from, &(struct dirty_rect){ x, 0, width, to_height }, filter);
+	}
+
+	const int same = !memcmp(whole.pixels, strips.pixels, whole.pitch * to_height);
+
+	if (!same) {
+		fprintf(stderr, "%s: strips of %d differ from one pass upscaling %zux%zu to %zux%zu\n",
+			filter == UPSCALE_NEAREST ? "nearest" : "bilinear", strip_width,
+			from_width, from_height, to_width, to_height);
+	}
+
+	free(from.pixels);
+	free(whole.pixels);
+	free(strips.pixels);
+
+	return same;
+}
+
+static double time_upscale(
+	struct work_queue *queue, size_t from_width, size_t from_height,
+	size_t to_width, size_t to_height, enum upscale_filter filter, int iterations)
+{
+	struct offscreen_buffer from = make_buffer(from_width, from_height, 0);
+	struct offscreen_buffer to = make_buffer(to_width, to_height, 0);
+	const struct dirty_rect everything = { 0, 0, to_width, to_height };
+	struct timespec t_start, t_end;
+
+	fill_random(&from);
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (int i = 0; i < iterations; ++i)
+		upscale(queue, &to, &from, &everything, filter);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	free(from.pixels);
+	free(to.pixels);
+
+	const double elapsed = (t_end.tv_sec - t_start.tv_sec) * 1e9
+		+ (t_end.tv_nsec - t_start.tv_nsec);
+
+	return elapsed / ((double)iterations * to_width * to_height);
+}
+
+int main(int argc, char **argv)
+{
+	const int iterations = argc > 1 ? atoi(argv[1]) : 100;
+
+	const char *threads = getenv("HANDMADE_RENDER_THREADS");
+	long thread_count = threads ? atoi(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+	if (thread_count < 1)
+		thread_count = 1;
+
+	/* both queues come out of one arena, like the engine's */
+	static uint8_t queue_storage[64 * 1024];
+	struct memory_arena queue_arena;
+	memory_arena_init(&queue_arena, queue_storage, sizeof(queue_storage));
+
+	struct work_queue *single = work_queue_create(&queue_arena, 0);
+	struct work_queue *parallel = work_queue_create(&queue_arena, thread_count - 1);
+
+	if (!single || !parallel || iterations < 1) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	/* fills in the selected kernels */
+	select_upscale_kernels();
+	const struct kernels selected = { "selected", upscale_nearest, upscale_blend, upscale_lerp };
+
+	int failures = 0;
+	int checks = 0;
+
+	static const enum upscale_filter filters[] = { UPSCALE_NEAREST, UPSCALE_BILINEAR };
+
+	for (int f = 0; f < 2; ++f) {
+		/* odd sizes for every vector tail, up and down scales, partial rects */
+		for (size_t from_width = 1; from_width <= 41; from_width += 4) {
+			for (size_t to_width = from_width; to_width <= 3 * from_width + 7; to_width += 3) {
+				const struct dirty_rect everything = { 0, 0, to_width, 9 };
+				const struct dirty_rect part = {
+					to_width / 3, 2, to_width - to_width / 3 - to_width / 5, 5 };
+
+				failures += !compare(single, &selected, from_width, 5, to_width, 9, &everything, filters[f]);
+				failures += !compare(single, &selected, from_width, 5, to_width, 9, &part, filters[f]);
+				failures += !compare(single, &selected, to_width, 9, from_width, 5,
+					&(struct dirty_rect){ 0, 0, from_width, 5 }, filters[f]);
+				checks += 3;
+			}
+		}
+
+		const struct dirty_rect full = { 0, 0, 1280, 720 };
+		failures += !compare(parallel, &selected, 960, 540, 1280, 720, &full, filters[f]);
+		failures += !compare(parallel, &selected, 640, 360, 1280, 720, &full, filters[f]);
+		checks += 2;
+
+		/* dirty rects upscale the same pixels a full pass would */
+		failures += !compare_strips(parallel, 1280, 16, 1920, 24, 37, filters[f]);
+		failures += !compare_strips(parallel, 853, 16, 1280, 24, 61, filters[f]);
+		checks += 2;
+	}
+
+	printf("%d comparisons against scalar\n", checks);
+
+	static const struct { size_t from_width, from_height, to_width, to_height; } sizes[] = {
+		{  640,  360, 1280,  720 },
+		{  960,  540, 1280,  720 },
+		{ 1280,  720, 1920, 1080 },
+		{ 1920, 1080, 3840, 2160 },
+	};
+	const int size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+	printf("from,to,filter,scalar_ns_per_pixel,selected_ns_per_pixel,%ld_threads_ns_per_pixel\n", thread_count);
+
+	for (int s = 0; s < size_count; ++s) {
+		for (int f = 0; f < 2; ++f) {
+			use_kernels(&scalar);
+			const double scalar_ns = time_upscale(single,
+				sizes[s].from_width, sizes[s].from_height,
+				sizes[s].to_width, sizes[s].to_height, filters[f], iterations);
+
+			use_kernels(&selected);
+			const double selected_ns = time_upscale(single,
+				sizes[s].from_width, sizes[s].from_height,
+				sizes[s].to_width, sizes[s].to_height, filters[f], iterations);
+			const double parallel_ns = time_upscale(parallel,
+				sizes[s].from_width, sizes[s].from_height,
+				sizes[s].to_width, sizes[s].to_height, filters[f], iterations);
+
+			printf("%zux%zu,%zux%zu,%s,%.3f,%.3f,%.3f\n",
+				sizes[s].from_width, sizes[s].from_height,
+				sizes[s].to_width, sizes[s].to_height,
+				filters[f] == UPSCALE_NEAREST ? "nearest" : "bilinear",
+				scalar_ns, selected_ns, parallel_ns);
+		}
+	}
+
+	work_queue_destroy(single);
+	work_queue_destroy(parallel);
+
+	if (failures) {
+		fprintf(stderr, "%d comparisons failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/* standard library */
+#include <stdio.h> /* fprintf, fopen */
+#include <stdlib.h> /* realloc, free, qsort */
+#include <string.h> /* memcmp, memcpy, memset, strcmp, strerror */
+#include <errno.h>
+
+/* system headers */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h> /* open() */
+#include <unistd.h> /* close() */
+
+#include "asset_pack.h"
+
+static const char magic[4] = { 'H', 'M', 'A', 'P' };
+
+static size_t align_up(size_t size)
+{
+	return (size + ASSET_PACK_ALIGNMENT - 1) & ~(size_t)(ASSET_PACK_ALIGNMENT - 1);
+}
+
+/* everything a lookup or the game will trust has to lie inside the file */
+static int check_index(const struct asset_pack *pack)
+{
+	const struct asset_pack_header *header = (const struct asset_pack_header*)pack->base;
+
+	if (pack->size < sizeof(*header)
+			|| memcmp(header->magic, magic, sizeof(magic))
+			|| header->version != ASSET_PACK_VERSION
+			|| header->size != pack->size
+			|| header->asset_count > (pack->size - sizeof(*header)) / sizeof(struct asset_pack_entry))
+		return 0;
+
+	const struct asset_pack_entry *entries = (const struct asset_pack_entry*)(header + 1);
+
+	for (uint32_t i = 0; i < header->asset_count; ++i) {
+		const struct asset_pack_entry *entry = &entries[i];
+		uint64_t needed;
+
+		if (entry->offset % ASSET_PACK_ALIGNMENT
+				|| entry->offset > pack->size
+				|| entry->size > pack->size - entry->offset
+				|| memchr(entry->name, '\0', sizeof(entry->name)) == NULL
+				|| (i && strcmp(entries[i - 1].name, entry->name) >= 0))
+			return 0;
+
+		switch (entry->type) {
+			case ASSET_BITMAP:
+				needed = (uint64_t)entry->bitmap.pitch * entry->bitmap.height;
+				if (entry->bitmap.pitch < (uint64_t)entry->bitmap.width * 4)
+					return 0;
+				break;
+
+			case ASSET_SOUND:
+				needed = entry->sound.frame_count * entry->sound.channels * sizeof(int16_t);
+				if (!entry->sound.channels || entry->sound.channels > 8
+						|| entry->sound.frame_count > entry->size)
+					return 0;
+				break;
+
+			default:
+				return 0;
+		}
+
+		if (needed > entry->size)
+			return 0;
+	}
+
+	return 1;
+}
+
+int asset_pack_open(struct asset_pack *pack, const char *path)
+{
+	memset(pack, 0, sizeof(*pack));
+
+	const int file_descriptor = open(path, O_RDONLY | O_CLOEXEC);
+	if (file_descriptor < 0) {
+		fprintf(stderr, "Unable to open asset pack %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	struct stat info;
+	if (fstat(file_descriptor, &info) < 0 || info.st_size <= 0) {
+		fprintf(stderr, "Unable to read asset pack %s\n", path);
+		close(file_descriptor);
+		return 0;
+	}
+
+	/* no MAP_POPULATE, pages come in as the game first touches them */
+	void *base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	close(file_descriptor);
+
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Unable to map asset pack %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	pack->base = base;
+	pack->size = info.st_size;
+
+	if (!check_index(pack)) {
+		fprintf(stderr, "%s is not an asset pack this build can load\n", path);
+		asset_pack_close(pack);
+		return 0;
+	}
+
+	const struct asset_pack_header *header = base;
+	pack->asset_count = header->asset_count;
+	pack->entries = (const struct asset_pack_entry*)(header + 1);
+
+	return 1;
+}
+
+void asset_pack_close(struct asset_pack *pack)
+{
+	if (pack->base)
+		munmap((void*)pack->base, pack->size);
+
+	memset(pack, 0, sizeof(*pack));
+}
+
+/*
+ * Writing
+ */
+
+void asset_pack_writer_begin(struct asset_pack_writer *writer)
+{
+	memset(writer, 0, sizeof(*writer));
+}
+
+static struct asset_pack_entry *add_entry(
+	struct asset_pack_writer *writer, const char *name, enum asset_type type,
+	const void *data, size_t row_size, size_t row_count, size_t pitch)
+{
+	if (strlen(name) >= ASSET_PACK_NAME_SIZE) {
+		fprintf(stderr, "Asset name %s is longer than %d characters\n", name, ASSET_PACK_NAME_SIZE - 1);
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < writer->asset_count; ++i) {
+		if (!strcmp(writer->entries[i].name, name)) {
+			fprintf(stderr, "Asset %s is in the pack twice\n", name);
+			return NULL;
+		}
+	}
+
+	if (writer->asset_count == writer->capacity) {
+		const uint32_t capacity = writer->capacity ? writer->capacity * 2 : 64;
+		struct asset_pack_entry *entries = realloc(writer->entries, capacity * sizeof(*entries));
+
+		if (!entries)
+			return NULL;
+
+		writer->entries = entries;
+		writer->capacity = capacity;
+	}
+
+	const size_t offset = align_up(writer->data_size);
+	const size_t size = pitch * row_count;
+
+	if (offset + size > writer->data_capacity) {
+		size_t capacity = writer->data_capacity ? writer->data_capacity : 1 << 20;
+		while (capacity < offset + size)
+			capacity *= 2;
+
+		uint8_t *grown = realloc(writer->data, capacity);
+		if (!grown)
+			return NULL;
+
+		writer->data = grown;
+		writer->data_capacity = capacity;
+	}
+
+	/* padding is zeroed so packs built from the same inputs are identical */
+	memset(writer->data + writer->data_size, 0, offset + size - writer->data_size);
+	for (size_t row = 0; row < row_count; ++row)
+		memcpy(writer->data + offset + row * pitch, (const uint8_t*)data + row * row_size, row_size);
+
+	struct asset_pack_entry *entry = &writer->entries[writer->asset_count++];
+	memset(entry, 0, sizeof(*entry));
+	snprintf(entry->name, sizeof(entry->name), "%s", name);
+	entry->type = type;
+	entry->offset = offset; /* relative to the data until the file is written */
+	entry->size = size;
+
+	writer->data_size = offset + size;
+	return entry;
+}
+
+int asset_pack_add_bitmap(
+	struct asset_pack_writer *writer, const char *name,
+	const uint32_t *pixels, uint32_t width, uint32_t height)
+{
+	const size_t row_size = (size_t)width * 4;
+	struct asset_pack_entry *entry = add_entry(
+		writer, name, ASSET_BITMAP, pixels, row_size, height, row_size);
+
+	if (!entry)
+		return 0;
+
+	entry->bitmap.width = width;
+	entry->bitmap.height = height;
+	entry->bitmap.pitch = row_size;
+	return 1;
+}
+
+int asset_pack_add_sound(
+	struct asset_pack_writer *writer, const char *name,
+	const int16_t *samples, uint32_t channels, uint32_t sample_rate, uint64_t frame_count)
+{
+	const size_t size = frame_count * channels * sizeof(int16_t);
+	struct asset_pack_entry *entry = add_entry(writer, name, ASSET_SOUND, samples, size, 1, size);
+
+	if (!entry)
+		return 0;
+
+	entry->sound.channels = channels;
+	entry->sound.sample_rate = sample_rate;
+	entry->sound.frame_count = frame_count;
+	return 1;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(((const struct asset_pack_entry*)a)->name, ((const struct asset_pack_entry*)b)->name);
+}
+
+int asset_pack_writer_finish(struct asset_pack_writer *writer, const char *path)
+{
+	const size_t data_offset = align_up(
+		sizeof(struct asset_pack_header) + writer->asset_count * sizeof(struct asset_pack_entry));
+
+	struct asset_pack_header header = {0};
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = ASSET_PACK_VERSION;
+	header.asset_count = writer->asset_count;
+	header.size = data_offset + writer->data_size;
+
+	qsort(writer->entries, writer->asset_count, sizeof(struct asset_pack_entry), compare_names);
+
+	for (uint32_t i = 0; i < writer->asset_count; ++i)
+		writer->entries[i].offset += data_offset;
+
+	static const uint8_t padding[ASSET_PACK_ALIGNMENT];
+	const size_t index_end = sizeof(header) + writer->asset_count * sizeof(struct asset_pack_entry);
+
+	FILE *file = fopen(path, "wb");
+	int written = file
+		&& fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(writer->entries, sizeof(struct asset_pack_entry), writer->asset_count, file) == writer->asset_count
+		&& fwrite(padding, 1, data_offset - index_end, file) == data_offset - index_end
+		&& fwrite(writer->data, 1, writer->data_size, file) == writer->data_size;
+
+	if (file && fclose(file))
+		written = 0;
+
+	if (!written)
+		fprintf(stderr, "Unable to write asset pack %s: %s\n", path, strerror(errno));
+
+	asset_pack_writer_discard(writer);
+	return written;
+}
+
+void asset_pack_writer_discard(struct asset_pack_writer *writer)
+{
+	free(writer->entries);
+	free(writer->data);
+	memset(writer, 0, sizeof(*writer));
+}
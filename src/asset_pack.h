@@ -0,0 +1,167 @@
+#ifndef HANDMADE_ASSET_PACK
+#define HANDMADE_ASSET_PACK
+
+#include <stdint.h> /* uint32_t, uint64_t */
+#include <string.h> /* strcmp */
+
+#include "platform.h"
+
+/*
+ * Every bitmap and sound the game uses, converted offline by asset_packer
+ * into the formats the engine draws and plays, so loading is a single
+ * mmap() and looking an asset up hands back a pointer into the mapping.
+ * Nothing is read until it is touched, so startup time and resident memory
+ * follow what the game uses rather than the size of the pack.
+ *
+ * The file is a header, then the index, then the data, in native byte
+ * order. The index is sorted by name, and each asset's data starts on an
+ * ASSET_PACK_ALIGNMENT boundary:
+ *
+ *   bitmaps  premultiplied ARGB, the layout of offscreen_buffer pixels
+ *   sounds   interleaved S16 PCM
+ */
+
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 64
+#define ASSET_PACK_NAME_SIZE 48
+
+enum asset_type
+{
+	ASSET_BITMAP = 1,
+	ASSET_SOUND = 2,
+};
+
+struct asset_pack_header
+{
+	char magic[4]; /* HMAP */
+	uint32_t version;
+	uint32_t asset_count;
+	uint32_t reserved;
+	uint64_t size; /* of the whole file */
+};
+
+struct asset_pack_entry
+{
+	char name[ASSET_PACK_NAME_SIZE]; /* NUL terminated */
+	uint32_t type; /* enum asset_type */
+	uint32_t reserved;
+	uint64_t offset; /* from the start of the file */
+	uint64_t size;
+
+	union {
+		struct {
+			uint32_t width;
+			uint32_t height;
+			uint32_t pitch;
+			uint32_t reserved;
+		} bitmap;
+
+		struct {
+			uint32_t channels;
+			uint32_t sample_rate;
+			uint64_t frame_count;
+		} sound;
+	};
+};
+
+/* a mapped pack, empty when there is no file */
+struct asset_pack
+{
+	const uint8_t *base;
+	size_t size;
+	uint32_t asset_count;
+	const struct asset_pack_entry *entries;
+};
+
+/* maps the pack at path and checks its index, returns 0 if it can't be used */
+int asset_pack_open(struct asset_pack *pack, const char *path);
+void asset_pack_close(struct asset_pack *pack);
+
+/*
+ * Building a pack: begin, add each asset, then finish, which sorts the
+ * index and writes the file. The data is copied as it is added.
+ */
+struct asset_pack_writer
+{
+	struct asset_pack_entry *entries;
+	uint32_t asset_count;
+	uint32_t capacity;
+	uint8_t *data;
+	size_t data_size;
+	size_t data_capacity;
+};
+
+void asset_pack_writer_begin(struct asset_pack_writer *writer);
+int asset_pack_add_bitmap(
+	struct asset_pack_writer *writer, const char *name,
+	const uint32_t *pixels, uint32_t width, uint32_t height);
+int asset_pack_add_sound(
+	struct asset_pack_writer *writer, const char *name,
+	const int16_t *samples, uint32_t channels, uint32_t sample_rate, uint64_t frame_count);
+/* writes the pack to path and frees the writer either way */
+int asset_pack_writer_finish(struct asset_pack_writer *writer, const char *path);
+/* frees the writer without writing anything */
+void asset_pack_writer_discard(struct asset_pack_writer *writer);
+
+/*
+ * Lookups only read the mapping, so they are inline and the game can call
+ * them without linking against the engine.
+ */
+
+static inline const struct asset_pack_entry *asset_pack_find(
+	const struct asset_pack *pack, const char *name, enum asset_type type)
+{
+	uint32_t low = 0, high = pack ? pack->asset_count : 0;
+
+	while (low < high) {
+		const uint32_t middle = low + (high - low) / 2;
+		const int order = strcmp(pack->entries[middle].name, name);
+
+		if (order == 0)
+			return pack->entries[middle].type == type ? &pack->entries[middle] : NULL;
+
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return NULL;
+}
+
+/*
+ * The bitmap's pixels, straight out of the mapping. They are read only:
+ * blit from the buffer, never draw into it. Empty if the asset is missing.
+ */
+static inline struct offscreen_buffer asset_pack_bitmap(const struct asset_pack *pack, const char *name)
+{
+	const struct asset_pack_entry *entry = asset_pack_find(pack, name, ASSET_BITMAP);
+	struct offscreen_buffer bitmap = {0};
+
+	if (entry) {
+		bitmap.pixels = (void*)(pack->base + entry->offset);
+		bitmap.width = entry->bitmap.width;
+		bitmap.height = entry->bitmap.height;
+		bitmap.pitch = entry->bitmap.pitch;
+	}
+
+	return bitmap;
+}
+
+/* the sound's samples and format, or NULL if the asset is missing */
+static inline const int16_t *asset_pack_sound(
+	const struct asset_pack *pack, const char *name,
+	uint32_t *channels, uint32_t *sample_rate, uint64_t *frame_count)
+{
+	const struct asset_pack_entry *entry = asset_pack_find(pack, name, ASSET_SOUND);
+
+	if (!entry)
+		return NULL;
+
+	*channels = entry->sound.channels;
+	*sample_rate = entry->sound.sample_rate;
+	*frame_count = entry->sound.frame_count;
+	return (const int16_t*)(pack->base + entry->offset);
+}
+
+#endif /* HANDMADE_ASSET_PACK */
@@ -0,0 +1,281 @@
+/* standard library */
+#include <stdint.h>
+#include <stdio.h> /* printf, fprintf, fopen */
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memcmp, strrchr, strerror */
+#include <strings.h> /* strcasecmp */
+#include <errno.h>
+
+#include "asset_pack.h"
+#include "byte_read.h"
+#include "wav.h"
+
+/*
+ * Builds an asset pack from source files, converting everything up front
+ * so the engine never decodes anything at runtime:
+ *
+ *   asset_packer output.pack file...
+ *
+ * Each asset is named after its file, without the directory or extension.
+ * Uncompressed .bmp files (24 bit, or 32 bit with alpha) become
+ * premultiplied ARGB and .wav files (8, 16, 24 or 32 bit PCM, or 32 bit
+ * float) become S16 at their own rate and channel count.
+ */
+
+struct file_data
+{
+	uint8_t *bytes;
+	size_t size;
+};
+
+static int read_file(const char *path, struct file_data *file)
+{
+	FILE *handle = fopen(path, "rb");
+	long size = -1;
+
+	file->bytes = NULL;
+
+	if (handle && fseek(handle, 0, SEEK_END) == 0)
+		size = ftell(handle);
+
+	if (size >= 0 && fseek(handle, 0, SEEK_SET) == 0) {
+		file->bytes = malloc(size ? size : 1);
+		file->size = size;
+
+		if (file->bytes && fread(file->bytes, 1, size, handle) != (size_t)size) {
+			free(file->bytes);
+			file->bytes = NULL;
+		}
+	}
+
+	if (handle)
+		fclose(handle);
+
+	if (!file->bytes) {
+		fprintf(stderr, "Unable to read %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+/* widest channel extract_channel() can scale without overflowing */
+#define MAX_CHANNEL_BITS 16
+
+static int mask_fits(uint32_t mask)
+{
+	if (!mask)
+		return 1;
+
+	while (!(mask & 1))
+		mask >>= 1;
+
+	return mask < 1u << MAX_CHANNEL_BITS;
+}
+
+/* the channel selected by mask scaled to 8 bits, or fallback without a mask */
+static uint32_t extract_channel(uint32_t pixel, uint32_t mask, uint32_t fallback)
+{
+	if (!mask)
+		return fallback;
+
+	int shift = 0;
+	while (!(mask >> shift & 1))
+		++shift;
+
+	const uint32_t maximum = mask >> shift;
+	return ((pixel & mask) >> shift) * 255 / maximum;
+}
+
+static int pack_bitmap(
+	struct asset_pack_writer *writer, const char *name, const char *path, const struct file_data *file)
+{
+	const uint8_t *bytes = file->bytes;
+
+	if (file->size < 54 || memcmp(bytes, "BM", 2)) {
+		fprintf(stderr, "%s is not a BMP file\n", path);
+		return 0;
+	}
+
+	const uint32_t pixel_offset = read_u32(bytes + 10);
+	const uint32_t header_size = read_u32(bytes + 14);
+	const int32_t width = (int32_t)read_u32(bytes + 18);
+	const int32_t signed_height = (int32_t)read_u32(bytes + 22);
+	const uint16_t bits = read_u16(bytes + 28);
+	const uint32_t compression = read_u32(bytes + 30);
+
+	/* checked before negating, INT32_MIN has no positive counterpart */
+	if (signed_height < -65536 || signed_height > 65536) {
+		fprintf(stderr, "%s: bad BMP dimensions\n", path);
+		return 0;
+	}
+
+	/* negative heights are stored top row first */
+	const int top_down = signed_height < 0;
+	const int32_t height = top_down ? -signed_height : signed_height;
+
+	uint32_t red_mask = 0x00ff0000, green_mask = 0x0000ff00, blue_mask = 0x000000ff;
+	uint32_t alpha_mask = bits == 32 ? 0xff000000 : 0;
+
+	if (compression == 3 && bits == 32 && file->size >= 66) {
+		/* BI_BITFIELDS, masks follow a 40 byte header or sit inside a bigger one */
+		red_mask = read_u32(bytes + 54);
+		green_mask = read_u32(bytes + 58);
+		blue_mask = read_u32(bytes + 62);
+		alpha_mask = header_size >= 56 && file->size >= 70 ? read_u32(bytes + 66) : 0;
+	} else if (compression != 0 || (bits != 24 && bits != 32)) {
+		fprintf(stderr, "%s: only uncompressed 24 and 32 bit BMPs are supported\n", path);
+		return 0;
+	}
+
+	if (!mask_fits(red_mask) || !mask_fits(green_mask) || !mask_fits(blue_mask) || !mask_fits(alpha_mask)) {
+		fprintf(stderr, "%s: channel masks wider than %d bits are not supported\n", path, MAX_CHANNEL_BITS);
+		return 0;
+	}
+
+	const size_t row_size = ((size_t)width * bits / 8 + 3) & ~(size_t)3;
+
+	if (width <= 0 || height <= 0 || width > 65536 || height > 65536
+			|| pixel_offset > file->size || row_size * height > file->size - pixel_offset) {
+		fprintf(stderr, "%s: bad BMP dimensions\n", path);
+		return 0;
+	}
+
+	uint32_t *pixels = malloc((size_t)width * height * 4);
+	if (!pixels) {
+		fprintf(stderr, "Unable to allocate %dx%d bitmap\n", width, height);
+		return 0;
+	}
+
+	/* plenty of tools write 32 bit BMPs with the alpha byte left at zero */
+	int has_alpha = 0;
+	for (int32_t y = 0; y < height && alpha_mask && !has_alpha; ++y) {
+		const uint8_t *row = bytes + pixel_offset + y * row_size;
+		for (int32_t x = 0; x < width && !has_alpha; ++x)
+			has_alpha = (read_u32(row + x * 4) & alpha_mask) != 0;
+	}
+
+	for (int32_t y = 0; y < height; ++y) {
+		const uint8_t *row = bytes + pixel_offset + (top_down ? y : height - 1 - y) * row_size;
+		uint32_t *to = pixels + (size_t)y * width;
+
+		for (int32_t x = 0; x < width; ++x) {
+			uint32_t r, g, b, a = 255;
+
+			if (bits == 24) {
+				b = row[x * 3];
+				g = row[x * 3 + 1];
+				r = row[x * 3 + 2];
+			} else {
+				const uint32_t pixel = read_u32(row + x * 4);
+				r = extract_channel(pixel, red_mask, 0);
+				g = extract_channel(pixel, green_mask, 0);
+				b = extract_channel(pixel, blue_mask, 0);
+				a = has_alpha ? extract_channel(pixel, alpha_mask, 255) : 255;
+			}
+
+			/* premultiplied, rounded, as raster_color() does */
+			to[x] = a << 24
+				| (r * a + 127) / 255 << 16
+				| (g * a + 127) / 255 << 8
+				| (b * a + 127) / 255;
+		}
+	}
+
+	const int added = asset_pack_add_bitmap(writer, name, pixels, width, height);
+	if (added)
+		printf("%s: %dx%d bitmap%s\n", name, width, height, has_alpha ? " with alpha" : "");
+
+	free(pixels);
+	return added;
+}
+
+static int pack_sound(
+	struct asset_pack_writer *writer, const char *name, const char *path, const struct file_data *file)
+{
+	struct wav_format format;
+
+	if (!wav_parse(&format, path, file->bytes, file->size, file->size))
+		return 0;
+
+	const uint8_t *data = file->bytes + format.data_offset;
+	const uint64_t frame_count = format.data_size / format.frame_size;
+	const unsigned int sample_size = format.bits / 8;
+
+	int16_t *samples = malloc(frame_count * format.channels * sizeof(int16_t) + 1);
+	if (!samples) {
+		fprintf(stderr, "Unable to allocate %llu frames of sound\n", (unsigned long long)frame_count);
+		return 0;
+	}
+
+	for (uint64_t i = 0; i < frame_count * format.channels; ++i)
+		samples[i] = wav_sample_to_s16(data + i * sample_size, &format);
+
+	const int added = asset_pack_add_sound(
+		writer, name, samples, format.channels, format.sample_rate, frame_count);
+	if (added) {
+		printf("%s: %.2f s of %u channel sound at %u Hz\n",
+			name, (double)frame_count / format.sample_rate, format.channels, format.sample_rate);
+	}
+
+	free(samples);
+	return added;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s output.pack file...\n", argv[0]);
+		return 1;
+	}
+
+	struct asset_pack_writer writer;
+	asset_pack_writer_begin(&writer);
+
+	int failed = 0;
+
+	for (int i = 2; i < argc && !failed; ++i) {
+		const char *path = argv[i];
+		const char *base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+		const char *extension = strrchr(base, '.');
+		char name[ASSET_PACK_NAME_SIZE + 1];
+		struct file_data file;
+
+		if (!extension || extension == base) {
+			fprintf(stderr, "%s has no extension to tell what it is\n", path);
+			failed = 1;
+			break;
+		}
+
+		/* one longer than any name fits, so asset_pack_add_* reports it */
+		snprintf(name, sizeof(name), "%.*s", (int)(extension - base), base);
+
+		if (!read_file(path, &file)) {
+			failed = 1;
+			break;
+		}
+
+		if (!strcasecmp(extension, ".bmp")) {
+			failed = !pack_bitmap(&writer, name, path, &file);
+		} else if (!strcasecmp(extension, ".wav")) {
+			failed = !pack_sound(&writer, name, path, &file);
+		} else {
+			fprintf(stderr, "%s: don't know how to pack %s files\n", path, extension);
+			failed = 1;
+		}
+
+		free(file.bytes);
+	}
+
+	if (failed) {
+		asset_pack_writer_discard(&writer);
+		return 1;
+	}
+
+	const uint32_t asset_count = writer.asset_count;
+	if (!asset_pack_writer_finish(&writer, argv[1]))
+		return 1;
+
+	printf("Wrote %u assets to %s\n", asset_count, argv[1]);
+	return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef HANDMADE_AUDIO_STREAM
+#define HANDMADE_AUDIO_STREAM
+
+#include "ring_buffer.h"
+#include "waker.h"
+
+/*
+ * The audio the main thread mixes, on its way to whichever thread plays
+ * it: the ring between the two, the waker the consumer sleeps on while
+ * the ring is empty, and what the consumer reports back. Every backend's
+ * audio thread is built around one of these.
+ */
+
+/* written by the audio thread, read with atomics by anyone who wants to graph them */
+struct audio_telemetry
+{
+	unsigned int underruns;
+	unsigned int target_latency; /* frames the main thread keeps queued */
+	unsigned int ring_fill; /* frames in the ring after the last device write */
+	unsigned int device_delay; /* frames queued in the device after the last write */
+};
+
+struct audio_stream
+{
+	unsigned int rate;
+	struct audio_telemetry telemetry;
+	int wait_timeout; /* ms, bounds every blocking wait */
+	struct waker wake; /* the audio thread sleeps on it while the ring is empty */
+	struct ring_buffer buffer; /* main thread produces, audio thread consumes */
+};
+
+/*
+ * Maps a mirrored ring of at least size frames, so neither side ever splits
+ * a span at the wrap. Returns 0 if the ring or the waker can't be
+ * created.
+ */
+static inline int audio_stream_init(
+	struct audio_stream *stream, unsigned int size, unsigned int frame_size,
+	unsigned int rate, unsigned int latency, int wait_timeout)
+{
+	stream->rate = rate;
+	stream->telemetry.target_latency = latency;
+	stream->wait_timeout = wait_timeout;
+
+	if (!ring_buffer_init_mirrored(&stream->buffer, size, frame_size))
+		return 0;
+
+	if (!waker_init(&stream->wake)) {
+		ring_buffer_destroy_mirrored(&stream->buffer);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* once the consumer has stopped */
+static inline void audio_stream_destroy(struct audio_stream *stream)
+{
+	waker_destroy(&stream->wake);
+	ring_buffer_destroy_mirrored(&stream->buffer);
+}
+
+/* called by the main thread after committing new frames to the ring */
+static inline void audio_stream_notify(struct audio_stream *stream)
+{
+	waker_notify(&stream->wake);
+}
+
+/* blocks the audio thread until the main thread has produced something, or timeout */
+static inline void audio_stream_wait(struct audio_stream *stream)
+{
+	waker_begin_wait(&stream->wake);
+
+	/* the producer may have committed before it could see the flag */
+	if (!ring_buffer_read_available(&stream->buffer))
+		waker_wait(&stream->wake, -1, stream->wait_timeout);
+
+	waker_end_wait(&stream->wake);
+}
+
+static inline void audio_stream_read_telemetry(
+	const struct audio_stream *stream, struct audio_telemetry *telemetry)
+{
+	telemetry->underruns = __atomic_load_n(&stream->telemetry.underruns, __ATOMIC_RELAXED);
+	telemetry->target_latency = __atomic_load_n(&stream->telemetry.target_latency, __ATOMIC_RELAXED);
+	telemetry->ring_fill = __atomic_load_n(&stream->telemetry.ring_fill, __ATOMIC_RELAXED);
+	telemetry->device_delay = __atomic_load_n(&stream->telemetry.device_delay, __ATOMIC_RELAXED);
+}
+
+#endif /* HANDMADE_AUDIO_STREAM */
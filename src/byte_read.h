@@ -0,0 +1,21 @@
+#ifndef HANDMADE_BYTE_READ
+#define HANDMADE_BYTE_READ
+
+#include <stdint.h> /* uint8_t, uint16_t, uint32_t */
+
+/*
+ * Little-endian reads from unaligned bytes, for the file formats the asset
+ * packer and the sound streamer parse.
+ */
+
+static inline uint16_t read_u16(const uint8_t *bytes)
+{
+	return bytes[0] | bytes[1] << 8;
+}
+
+static inline uint32_t read_u32(const uint8_t *bytes)
+{
+	return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+#endif /* HANDMADE_BYTE_READ */
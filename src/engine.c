@@ -0,0 +1,750 @@
+/* standard library */
+#include <stdint.h>
+#include <stdio.h> /* printf, fprintf */
+#include <stdlib.h> /* getenv, atoi */
+#include <string.h> /* strcmp, strerror */
+#include <errno.h>
+#include <time.h>
+
+/* system headers */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h> /* open() */
+#include <unistd.h> /* read(), readlink(), access() */
+#include <dlfcn.h> /* dlopen() */
+#include <limits.h> /* PATH_MAX */
+#include <libgen.h> /* dirname() */
+
+#include "engine.h"
+#include "mixer.h"
+#include "profiler.h"
+#include "trace.h"
+#include "frame_pacer.h"
+#include "work_queue.h"
+#include "upscale.h"
+#include "resolution_controller.h"
+#include "asset_pack.h"
+#include "sound_stream.h"
+
+/*
+ * Dynamic resolution
+ *
+ * Below full resolution the game draws into a render target of its own,
+ * and whatever it marks dirty there is upscaled into the buffer being
+ * presented. At full resolution it draws straight into that buffer.
+ */
+struct render_target
+{
+	struct offscreen_buffer pixels; /* storage for the biggest window */
+	struct resolution_controller controller;
+	enum upscale_filter filter;
+	size_t present_width; /* the buffer last upscaled into */
+	size_t present_height;
+	int upscale_everything; /* the target or the window changed size */
+};
+
+/*
+ * HANDMADE_UPSCALE=nearest trades the bilinear filter's smoothness for a
+ * cheaper blit, and HANDMADE_DYNAMIC_RESOLUTION=0 always renders at full
+ * resolution. A fixed_scale other than 0 pins the scale there.
+ */
+static int init_render_target(
+	struct render_target *target, struct memory_arena *arena,
+	unsigned int max_width, unsigned int max_height, uint64_t budget_ns, float fixed_scale)
+{
+	const char *dynamic = getenv("HANDMADE_DYNAMIC_RESOLUTION");
+	const char *filter = getenv("HANDMADE_UPSCALE");
+
+	memset(target, 0, sizeof(*target));
+	target->filter = filter && !strcmp(filter, "nearest") ? UPSCALE_NEAREST : UPSCALE_BILINEAR;
+
+	float min_scale = dynamic && !atoi(dynamic) ? 1.0f : 0.5f;
+	float max_scale = 1.0f;
+
+	if (fixed_scale > 0.0f) {
+		min_scale = fixed_scale < 1.0f ? fixed_scale : 1.0f;
+		max_scale = min_scale;
+	}
+
+	resolution_controller_init(&target->controller, budget_ns, min_scale, max_scale);
+
+	if (min_scale == 1.0f)
+		return 1;
+
+	target->pixels.pitch = (max_width * 4 + 63) & ~(size_t)63;
+	target->pixels.pixels = memory_arena_push(arena, target->pixels.pitch * max_height, 64);
+
+	if (!target->pixels.pixels) {
+		fprintf(stderr, "Unable to allocate render target, rendering at full resolution\n");
+		resolution_controller_init(&target->controller, budget_ns, 1.0f, 1.0f);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* rounded down to a multiple of 8, which keeps small changes in scale from resizing it */
+static size_t scaled_size(size_t size, float scale)
+{
+	if (scale >= 1.0f)
+		return size;
+
+	size_t scaled = (size_t)(size * scale) & ~(size_t)7;
+	if (scaled < 8)
+		scaled = 8;
+
+	return scaled < size ? scaled : size;
+}
+
+/* where the game draws this frame, the backbuffer itself at full resolution */
+static struct offscreen_buffer *begin_render(
+	struct render_target *target, struct offscreen_buffer *backbuffer)
+{
+	const float scale = target->controller.scale;
+	const size_t width = scaled_size(backbuffer->width, scale);
+	const size_t height = scaled_size(backbuffer->height, scale);
+
+	if (width == backbuffer->width && height == backbuffer->height)
+		return backbuffer;
+
+	if (width != target->pixels.width || height != target->pixels.height
+			|| backbuffer->width != target->present_width
+			|| backbuffer->height != target->present_height) {
+		target->pixels.width = width;
+		target->pixels.height = height;
+		target->present_width = backbuffer->width;
+		target->present_height = backbuffer->height;
+		target->upscale_everything = 1;
+	}
+
+	target->pixels.dirty_count = 0;
+	return &target->pixels;
+}
+
+/* stretches what the game changed in the target over the backbuffer */
+static void finish_render(
+	struct render_target *target, struct work_queue *queue,
+	struct offscreen_buffer *canvas, struct offscreen_buffer *backbuffer)
+{
+	if (canvas == backbuffer) {
+		/* the next frame drawn into the target can't rely on what it holds */
+		target->present_width = 0;
+		return;
+	}
+
+	TRACE_SCOPE("upscale");
+
+	if (target->upscale_everything) {
+		canvas->dirty_count = 0;
+		offscreen_buffer_mark_dirty(canvas, 0, 0, canvas->width, canvas->height);
+		target->upscale_everything = 0;
+	}
+
+	for (unsigned int i = 0; i < canvas->dirty_count; ++i) {
+		const struct dirty_rect rect = upscale_dirty_rect(backbuffer, canvas, &canvas->dirty[i]);
+
+		upscale(queue, backbuffer, canvas, &rect, target->filter);
+		offscreen_buffer_mark_dirty(backbuffer, rect.x, rect.y, rect.width, rect.height);
+	}
+}
+
+/*
+ * Memory
+ */
+
+#define MEMORY_PAGE_SIZE 4096
+#define MEMORY_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define PLATFORM_STORAGE_SIZE (4 * 1024 * 1024)
+#define GAME_PERMANENT_STORAGE_SIZE (64 * 1024 * 1024)
+#define GAME_TRANSIENT_STORAGE_SIZE (32 * 1024 * 1024)
+
+struct memory_reservation
+{
+	struct memory_arena arena;
+	int huge_pages;
+	int locked;
+};
+
+/*
+ * Maps the one block everything is allocated from, zeroed and faulted in up
+ * front so the frame loop never takes a page fault on fresh memory. Explicit
+ * huge pages are used when the system has them reserved, otherwise the
+ * kernel is asked to back the block with transparent huge pages. Locking it
+ * keeps it out of swap but needs a big enough RLIMIT_MEMLOCK, so failing to
+ * lock only warns.
+ */
+static int reserve_memory(struct memory_reservation *reservation, size_t size)
+{
+	size = (size + MEMORY_HUGE_PAGE_SIZE - 1) & ~(size_t)(MEMORY_HUGE_PAGE_SIZE - 1);
+
+	void *base = mmap(
+		NULL, size,
+		PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE | MAP_HUGETLB,
+		-1, 0);
+
+	reservation->huge_pages = base != MAP_FAILED;
+
+	if (!reservation->huge_pages) {
+		base = mmap(
+			NULL, size,
+			PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE,
+			-1, 0);
+
+		if (base == MAP_FAILED) {
+			fprintf(stderr, "Unable to reserve %zu bytes of memory: %s\n", size, strerror(errno));
+			return 0;
+		}
+
+		madvise(base, size, MADV_HUGEPAGE);
+	}
+
+	reservation->locked = mlock(base, size) == 0;
+	if (!reservation->locked)
+		fprintf(stderr, "Unable to lock memory, continuing unlocked: %s\n", strerror(errno));
+
+	memory_arena_init(&reservation->arena, base, size);
+	return 1;
+}
+
+/* one render thread per core unless HANDMADE_RENDER_THREADS says otherwise */
+static struct work_queue *create_render_queue(struct memory_arena *arena)
+{
+	const char *threads = getenv("HANDMADE_RENDER_THREADS");
+	long thread_count = threads ? atoi(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (thread_count < 1)
+		thread_count = 1;
+
+	/* the main thread is one of them */
+	return work_queue_create(arena, thread_count - 1);
+}
+
+/*
+ * The game lives in game.so next to the executable. Each time its
+ * modification time changes it is copied aside and the copy is loaded, so
+ * the build can replace game.so while the old code is still mapped.
+ */
+struct game_code
+{
+	void *library;
+	game_update_fn *update;
+	game_render_fn *render;
+	struct timespec loaded_mtime;
+	unsigned int generation;
+	char path[PATH_MAX];
+	char copy_path[PATH_MAX + 16]; /* path plus the copy suffix */
+};
+
+/* stand-ins while no game code is loaded */
+static GAME_UPDATE(game_update_stub) { (void)memory; (void)input; (void)dt; }
+static GAME_RENDER(game_render_stub) { (void)memory; (void)buffer; (void)alpha; }
+
+static void unload_game_code(struct game_code *code)
+{
+	if (code->library) {
+#ifndef HANDMADE_TRACE
+		/* traces keep pointers to the library's scope names until they are flushed */
+		dlclose(code->library);
+#endif
+		code->library = NULL;
+	}
+
+	code->update = game_update_stub;
+	code->render = game_render_stub;
+}
+
+static int copy_file(const char *from, const char *to)
+{
+	char block[64 * 1024];
+	int result = 0;
+
+	const int in = open(from, O_RDONLY | O_CLOEXEC);
+	const int out = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+
+	if (in >= 0 && out >= 0) {
+		ssize_t size;
+		result = 1;
+
+		while ((size = read(in, block, sizeof(block))) > 0) {
+			if (write(out, block, size) != size) {
+				result = 0;
+				break;
+			}
+		}
+
+		if (size < 0)
+			result = 0;
+	}
+
+	if (in >= 0)
+		close(in);
+	if (out >= 0)
+		close(out);
+
+	return result;
+}
+
+static void load_game_code(struct game_code *code, const struct timespec *mtime)
+{
+	unload_game_code(code);
+
+	/* a new name each time, dlopen hands back a library it still has open by name */
+	snprintf(code->copy_path, sizeof(code->copy_path), "%s.%u.loaded", code->path, code->generation++);
+
+	if (!copy_file(code->path, code->copy_path)) {
+		fprintf(stderr, "Unable to copy %s: %s\n", code->path, strerror(errno));
+		return;
+	}
+
+	code->library = dlopen(code->copy_path, RTLD_NOW | RTLD_LOCAL);
+	unlink(code->copy_path);
+
+	if (!code->library) {
+		fprintf(stderr, "Unable to load game code: %s\n", dlerror());
+		return;
+	}
+
+	game_update_fn *update = (game_update_fn*)dlsym(code->library, "game_update");
+	game_render_fn *render = (game_render_fn*)dlsym(code->library, "game_render");
+
+	if (!update || !render) {
+		fprintf(stderr, "Game code is missing entry points: %s\n", dlerror());
+		unload_game_code(code);
+		return;
+	}
+
+	code->update = update;
+	code->render = render;
+	code->loaded_mtime = *mtime;
+	printf("Loaded game code from %s\n", code->path);
+}
+
+static void reload_game_code_if_changed(struct game_code *code)
+{
+	struct stat info;
+
+	if (stat(code->path, &info) < 0)
+		return; /* mid-rebuild, keep running the old code */
+
+	if (code->library
+			&& info.st_mtim.tv_sec == code->loaded_mtime.tv_sec
+			&& info.st_mtim.tv_nsec == code->loaded_mtime.tv_nsec)
+		return;
+
+	load_game_code(code, &info.st_mtim);
+}
+
+static void init_game_code(struct game_code *code)
+{
+	char executable[PATH_MAX];
+	const ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+
+	unload_game_code(code);
+
+	if (length < 0) {
+		snprintf(code->path, sizeof(code->path), "./game.so");
+	} else {
+		executable[length] = '\0';
+		snprintf(code->path, sizeof(code->path), "%s/game.so", dirname(executable));
+	}
+
+	reload_game_code_if_changed(code);
+}
+
+/*
+ * HANDMADE_ASSET_PACK names the pack, otherwise it is assets.pack next to
+ * the executable, and running without one is fine.
+ */
+static int open_assets(struct asset_pack *assets)
+{
+	const char *path = getenv("HANDMADE_ASSET_PACK");
+	char default_path[PATH_MAX + 16];
+
+	if (!path) {
+		char executable[PATH_MAX];
+		const ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+
+		if (length < 0)
+			return 0;
+
+		executable[length] = '\0';
+		snprintf(default_path, sizeof(default_path), "%s/assets.pack", dirname(executable));
+		path = default_path;
+
+		if (access(path, F_OK) < 0)
+			return 0;
+	}
+
+	if (!asset_pack_open(assets, path))
+		return 0;
+
+	printf("Mapped %u assets (%zu KB) from %s\n", assets->asset_count, assets->size >> 10, path);
+	return 1;
+}
+
+static int input_key_pressed(const struct input_frame *input, uint32_t keysym)
+{
+	for (unsigned int i = 0; i < input->key_count; ++i) {
+		if (input->keys[i] == keysym)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* held on any connected pad */
+static int input_button_held(const struct input_frame *input, uint8_t button)
+{
+	for (int i = 0; i < INPUT_MAX_CONTROLLERS; ++i) {
+		if (input->controllers[i].connected && (input->controllers[i].buttons & button))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* the lowest connected pad, or an idle one if none are plugged in */
+static const struct input_controller *input_first_controller(const struct input_frame *input)
+{
+	static const struct input_controller idle = {0};
+
+	for (int i = 0; i < INPUT_MAX_CONTROLLERS; ++i) {
+		if (input->controllers[i].connected)
+			return &input->controllers[i];
+	}
+
+	return &idle;
+}
+
+int engine_run(struct platform_backend *backend, const struct engine_options *options)
+{
+	TRACE_THREAD_NAME("main");
+
+	/*
+	 * Everything the platform and the game allocate comes out of one
+	 * reservation made here. Game memory lives in it too so it survives
+	 * the game code being reloaded. The platform's share grows with the
+	 * biggest frame the backend hands out, it holds the render target and
+	 * whatever the backend needs for itself.
+	 */
+	const size_t platform_storage_size = PLATFORM_STORAGE_SIZE + backend->storage_size
+		+ (size_t)backend->max_width * backend->max_height * 4;
+
+	static struct memory_reservation reservation;
+	if (!reserve_memory(&reservation,
+			platform_storage_size + GAME_PERMANENT_STORAGE_SIZE + GAME_TRANSIENT_STORAGE_SIZE)) {
+		return -1;
+	}
+
+	static struct memory_arena platform_arena;
+	static struct game_memory game_memory;
+	if (!memory_arena_sub(&reservation.arena, &platform_arena, platform_storage_size, MEMORY_PAGE_SIZE)
+			|| !memory_arena_sub(&reservation.arena, &game_memory.permanent, GAME_PERMANENT_STORAGE_SIZE, MEMORY_PAGE_SIZE)
+			|| !memory_arena_sub(&reservation.arena, &game_memory.transient, GAME_TRANSIENT_STORAGE_SIZE, MEMORY_PAGE_SIZE)) {
+		fprintf(stderr, "Unable to fit the platform and game arenas in the %zu MB reservation\n",
+			reservation.arena.size >> 20);
+		return -1;
+	}
+
+	printf("Reserved %zu MB (%s pages, %s)\n",
+		reservation.arena.size >> 20,
+		reservation.huge_pages ? "huge" : "normal",
+		reservation.locked ? "locked" : "unlocked");
+
+	if (!backend->start(backend, &platform_arena))
+		return -1;
+
+	const int base_hz = 261; /* middle c */
+	const int audio_sample_rate = 48000;
+	const int16_t tone_volume = 6000;
+	struct audio_stream *audio = backend->start_audio(
+			backend, &platform_arena,
+			audio_sample_rate, audio_sample_rate, audio_sample_rate / 60);
+
+	static struct mixer mixer;
+	mixer_voice_handle tone_voice = MIXER_INVALID_VOICE;
+
+	if (audio && mixer_init(&mixer, &platform_arena, audio_sample_rate, 256, 256)) {
+		/* glides up from silence on the first frame */
+		tone_voice = mixer_play_tone(&mixer, 0, 0, 0);
+	} else if (audio) {
+		/* no mixer, no sound */
+		audio = NULL;
+	}
+
+	/*
+	 * HANDMADE_MUSIC_FILE loops a WAV file under the tone, streamed from
+	 * disk by a reader thread so only a few chunks of it are ever in memory.
+	 */
+	static struct sound_streamer streamer;
+	const char *music_file = getenv("HANDMADE_MUSIC_FILE");
+	struct sound_stream *music = NULL;
+	int streaming = 0;
+
+	if (audio && music_file && sound_streamer_start(&streamer, &platform_arena, audio_sample_rate)) {
+		streaming = 1;
+		music = sound_streamer_open(&streamer, music_file, 1);
+		mixer_play_stream(&mixer, music, 0.5f, 0.0f);
+	}
+
+	/* about a minute of frames at 60fps */
+	static struct profiler profiler;
+	profiler_init(&profiler, &platform_arena, 4096);
+
+	game_memory.platform.run_work = work_queue_run;
+	game_memory.platform.render_queue = create_render_queue(&platform_arena);
+
+	static struct asset_pack assets;
+	if (open_assets(&assets))
+		game_memory.platform.assets = &assets;
+
+	static struct game_code game;
+	init_game_code(&game);
+
+	/*
+	 * The simulation steps at a fixed rate, independent of how fast frames
+	 * are drawn, and rendering interpolates between the last two steps.
+	 */
+	const double update_dt = 1.0 / 120.0;
+	double update_accumulator = 0.0;
+	uint64_t last_frame_ns = profiler_now_ns();
+
+	/*
+	 * HANDMADE_RECORD_FILE logs every frame's input, frame time included,
+	 * and HANDMADE_REPLAY_FILE plays such a log back in place of live input
+	 * and quits when it runs out, so runs can be compared like for like.
+	 */
+	static struct input_recording recording;
+	const char *record_file = getenv("HANDMADE_RECORD_FILE");
+	const char *replay_file = options->replay_file ? options->replay_file : getenv("HANDMADE_REPLAY_FILE");
+
+	if (replay_file) {
+		if (!input_recording_replay(&recording, replay_file))
+			return -1;
+	} else if (record_file) {
+		if (!input_recording_record(&recording, record_file))
+			return -1;
+	}
+
+	/* HANDMADE_TARGET_FPS=0 runs uncapped */
+	const char *target_fps = getenv("HANDMADE_TARGET_FPS");
+	struct frame_pacer pacer;
+	frame_pacer_init(&pacer, target_fps ? (unsigned int)atoi(target_fps) : options->target_fps);
+
+	/* resolution drops to hold the pacer's rate, or 60fps when uncapped */
+	static struct render_target render_target;
+	init_render_target(&render_target, &platform_arena, backend->max_width, backend->max_height,
+		pacer.period_ns ? pacer.period_ns : 1000000000 / 60, options->render_scale);
+
+	unsigned long long dropped_frames = 0;
+	const uint64_t start_ns = profiler_now_ns();
+	int running = 1;
+
+	while(running) {
+		profiler_begin_frame(&profiler);
+		TRACE_SCOPE("frame");
+
+		reload_game_code_if_changed(&game);
+		memory_arena_reset(&game_memory.transient);
+
+		/*
+		 * The time the last frame kept the CPU busy, sleeping aside. A
+		 * replay holds the scale so every run of it renders the same.
+		 */
+		const struct frame_record *last_frame = profiler_last_frame(&profiler);
+		if (last_frame && recording.mode != INPUT_RECORDING_REPLAY) {
+			resolution_controller_update(&render_target.controller,
+				last_frame->frame_ns - last_frame->stage_ns[PROFILE_WAIT]);
+		}
+
+		struct input_frame live_input = {0};
+
+		if (!backend->poll_input(backend, &live_input))
+			running = 0;
+
+		profiler_mark(&profiler, PROFILE_EVENTS);
+
+		{
+			const uint64_t frame_ns = profiler_now_ns();
+			uint64_t frame_dt_ns = frame_ns - last_frame_ns;
+			last_frame_ns = frame_ns;
+
+			/* after a long stall, drop time rather than spiral trying to catch up */
+			if (frame_dt_ns > 250000000)
+				frame_dt_ns = 250000000;
+
+			live_input.frame_ns = options->frame_ns ? options->frame_ns : frame_dt_ns;
+		}
+
+		struct input_frame input;
+
+		if (recording.mode == INPUT_RECORDING_REPLAY) {
+			/* live input is ignored apart from being able to quit */
+			if (input_key_pressed(&live_input, ENGINE_KEY_ESCAPE))
+				running = 0;
+
+			if (!input_recording_read(&recording, &input))
+				break;
+		} else {
+			input = live_input;
+			input_recording_write(&recording, &input);
+		}
+
+		if (input_key_pressed(&input, ENGINE_KEY_ESCAPE) || input_button_held(&input, INPUT_BUTTON_B)) {
+			running = 0;
+		}
+
+		profiler_mark(&profiler, PROFILE_RECORDING);
+
+		// update audio
+		if (audio) {
+			TRACE_SCOPE("audio fill");
+
+			struct ring_buffer *audio_buffer = &audio->buffer;
+			unsigned int frames_to_write;
+
+			const unsigned int latency = __atomic_load_n(&audio->telemetry.target_latency, __ATOMIC_RELAXED);
+			const unsigned int fill = ring_buffer_fill(audio_buffer);
+
+			/* the first pad plays the tone */
+			const struct input_controller *player = input_first_controller(&input);
+			const float tone_hz = base_hz + ((player->stick_x - player->stick_y) * base_hz / 4);
+
+			/* keep the ring topped up to the target latency ahead of the audio thread */
+			frames_to_write = latency > fill ? latency - fill : 0;
+
+			/* glide to the new tone across everything written this frame */
+			mixer_set_frequency(&mixer, tone_voice, tone_hz, frames_to_write);
+			mixer_set_volume(&mixer, tone_voice,
+				(player->buttons & INPUT_BUTTON_A ? 1 : 0) * tone_volume / 32767.0f);
+
+			/* the ring is mirrored, one span whether it wraps or not */
+			mixer_mix(&mixer, ring_buffer_frame(audio_buffer, audio_buffer->write_cursor), frames_to_write);
+
+			ring_buffer_commit_write(audio_buffer, frames_to_write);
+			audio_stream_notify(audio);
+
+			if (streaming)
+				sound_streamer_notify(&streamer);
+		} // update audio
+
+		profiler_mark(&profiler, PROFILE_AUDIO);
+
+		{
+			update_accumulator += input.frame_ns * 1e-9;
+
+			struct game_input game_input = {0};
+
+			for (int i = 0; i < INPUT_MAX_CONTROLLERS && i < GAME_MAX_CONTROLLERS; ++i) {
+				const struct input_controller *controller = &input.controllers[i];
+
+				game_input.controllers[i].connected = controller->connected;
+				game_input.controllers[i].stick_x = controller->stick_x;
+				game_input.controllers[i].stick_y = controller->stick_y;
+			}
+
+			while (update_accumulator >= update_dt) {
+				game.update(&game_memory, &game_input, update_dt);
+				update_accumulator -= update_dt;
+			}
+		}
+
+		/* with every buffer still on its way to the screen this frame isn't drawn */
+		struct offscreen_buffer *backbuffer = backend->acquire_backbuffer(backend);
+
+		if (backbuffer) {
+			struct offscreen_buffer *canvas = begin_render(&render_target, backbuffer);
+			game.render(&game_memory, canvas, update_accumulator / update_dt);
+			finish_render(&render_target, game_memory.platform.render_queue, canvas, backbuffer);
+		} else {
+			++dropped_frames;
+		}
+
+		profiler_mark(&profiler, PROFILE_RENDER);
+
+		if (backbuffer)
+			backend->present(backend);
+
+		profiler_mark(&profiler, PROFILE_PRESENT);
+
+		frame_pacer_wait(&pacer);
+		profiler_mark(&profiler, PROFILE_WAIT);
+
+		if (options->frame_limit && profiler.frames + 1 >= options->frame_limit)
+			running = 0;
+
+		const int sample_count = 60;
+		if (profiler.frames && profiler.frames % sample_count == 0) {
+			const double t_avg = profiler_mean_frame_ns(&profiler, sample_count);
+			printf("\r%4.2f ms, %4.2f fps, %3.0f%% resolution",
+				t_avg * 1e-6, 1 / (t_avg * 1e-9), render_target.controller.scale * 100);
+
+			if (audio) {
+				struct audio_telemetry telemetry;
+				audio_stream_read_telemetry(audio, &telemetry);
+				printf(", audio latency %u (ring %u, device %u), %u underruns",
+					telemetry.target_latency, telemetry.ring_fill,
+					telemetry.device_delay, telemetry.underruns);
+			}
+
+			fflush(stdout);
+		}
+	}
+
+	/* finish the last frame */
+	profiler_begin_frame(&profiler);
+
+	const double elapsed_s = (profiler_now_ns() - start_ns) * 1e-9;
+
+	putchar('\n');
+
+	const struct resolution_controller *controller = &render_target.controller;
+	printf("%s: %llu frames in %.2f s, %.1f fps at %.0f%% resolution%s\n", backend->name,
+		(unsigned long long)profiler.frames, elapsed_s, profiler.frames / elapsed_s,
+		controller->scale * 100, controller->min_scale < controller->max_scale ? " (dynamic)" : "");
+
+	if (dropped_frames)
+		printf("Dropped %llu frames waiting for the display\n", dropped_frames);
+
+	if (recording.mode == INPUT_RECORDING_RECORD)
+		printf("Recorded %llu frames of input to %s\n", (unsigned long long)recording.frames, record_file);
+	else if (recording.mode == INPUT_RECORDING_REPLAY)
+		printf("Replayed %llu frames of input from %s\n", (unsigned long long)recording.frames, replay_file);
+
+	input_recording_close(&recording);
+
+	profiler_report(&profiler, stdout);
+
+	const char *profile_file = getenv("HANDMADE_PROFILE_FILE");
+	if (profile_file)
+		profiler_dump(&profiler, profile_file);
+
+#ifdef HANDMADE_TRACE
+	const char *trace_file = getenv("HANDMADE_TRACE_FILE");
+	trace_flush(trace_file ? trace_file : "trace.json");
+#endif
+
+	if (audio) {
+		struct audio_telemetry telemetry;
+		audio_stream_read_telemetry(audio, &telemetry);
+		printf("Audio: %u underruns, latency %u frames\n", telemetry.underruns, telemetry.target_latency);
+	}
+
+	if (music)
+		printf("Music: %u blocks starved waiting for the disk\n", music->starved);
+
+	printf("Memory used: platform %zu KB, game permanent %zu KB, game transient %zu KB peak\n",
+		platform_arena.peak >> 10, game_memory.permanent.peak >> 10,
+		game_memory.transient.peak >> 10);
+
+	backend->stop(backend);
+
+	if (streaming)
+		sound_streamer_stop(&streamer);
+
+	asset_pack_close(&assets);
+	return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef HANDMADE_ENGINE
+#define HANDMADE_ENGINE
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+#include "platform.h"
+#include "memory_arena.h"
+#include "input_recording.h"
+#include "audio_stream.h"
+
+/*
+ * The frame loop every platform backend shares: memory, the game code and
+ * its hot reload, input recording, the mixer, frame pacing, dynamic
+ * resolution and the profiler all live here, and a backend only supplies
+ * the window, input and sound through a platform_backend.
+ */
+
+/* the keysym that quits, the same value as X11's XK_Escape so recordings
+ * work on every backend */
+#define ENGINE_KEY_ESCAPE 0xff1b
+
+struct platform_backend
+{
+	const char *name;
+
+	/* set before engine_run(): the biggest buffer acquire_backbuffer() can
+	 * return, and what start() allocates from the platform arena */
+	unsigned int max_width;
+	unsigned int max_height;
+	size_t storage_size;
+
+	/* brings up the window or its stand-in, returns 0 on failure */
+	int (*start)(struct platform_backend *backend, struct memory_arena *arena);
+
+	/* NULL when there is no sound */
+	struct audio_stream *(*start_audio)(
+		struct platform_backend *backend, struct memory_arena *arena,
+		unsigned int sample_rate, unsigned int buffer_size, unsigned int latency);
+
+	/* keys and controllers for this frame, returns 0 once the user asked to quit */
+	int (*poll_input)(struct platform_backend *backend, struct input_frame *input);
+
+	/* the buffer to draw the next frame into, NULL to drop the frame */
+	struct offscreen_buffer *(*acquire_backbuffer)(struct platform_backend *backend);
+
+	/* sends off what was drawn into the buffer acquired last */
+	void (*present)(struct platform_backend *backend);
+
+	void (*stop)(struct platform_backend *backend);
+};
+
+struct engine_options
+{
+	unsigned int target_fps; /* HANDMADE_TARGET_FPS overrides it, 0 runs uncapped */
+	uint64_t frame_limit; /* stop after this many frames, 0 runs until quit */
+	uint64_t frame_ns; /* game time per frame, 0 follows the clock */
+	const char *replay_file; /* in place of HANDMADE_REPLAY_FILE if set */
+	float render_scale; /* fraction of the window to render at, 0 follows the frame budget */
+};
+
+/* runs the game on the backend until it quits, returns the exit status */
+int engine_run(struct platform_backend *backend, const struct engine_options *options);
+
+#endif /* HANDMADE_ENGINE */
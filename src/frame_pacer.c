@@ -0,0 +1,62 @@
+/* standard library */
+#include <errno.h>
+#include <time.h> /* clock_nanosleep */
+
+#include "frame_pacer.h"
+
+#define MIN_SPIN_NS 100000ull /* 0.1ms */
+#define MAX_SPIN_NS 2000000ull /* 2ms */
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void frame_pacer_init(struct frame_pacer *pacer, unsigned int hz)
+{
+	pacer->period_ns = hz ? 1000000000ull / hz : 0;
+	pacer->deadline_ns = now_ns() + pacer->period_ns;
+	pacer->spin_ns = 500000ull;
+	pacer->oversleep_ns = 0;
+}
+
+void frame_pacer_wait(struct frame_pacer *pacer)
+{
+	if (!pacer->period_ns)
+		return;
+
+	const uint64_t deadline = pacer->deadline_ns;
+	uint64_t now = now_ns();
+
+	if (now + pacer->spin_ns < deadline) {
+		const uint64_t wake = deadline - pacer->spin_ns;
+		const struct timespec wake_time = {
+			(time_t)(wake / 1000000000ull), (long)(wake % 1000000000ull)
+		};
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_time, NULL) == EINTR);
+
+		now = now_ns();
+
+		/* spin for twice the typical lateness */
+		const uint64_t late = now > wake ? now - wake : 0;
+		pacer->oversleep_ns = (pacer->oversleep_ns * 7 + late) / 8;
+		pacer->spin_ns = 2 * pacer->oversleep_ns;
+		if (pacer->spin_ns < MIN_SPIN_NS)
+			pacer->spin_ns = MIN_SPIN_NS;
+		if (pacer->spin_ns > MAX_SPIN_NS)
+			pacer->spin_ns = MAX_SPIN_NS;
+	}
+
+	while (now < deadline)
+		now = now_ns();
+
+	/* a frame that overran by more than a period starts a fresh schedule
+	 * rather than rushing the next frames to catch up */
+	if (now - deadline > pacer->period_ns)
+		pacer->deadline_ns = now + pacer->period_ns;
+	else
+		pacer->deadline_ns = deadline + pacer->period_ns;
+}
@@ -0,0 +1,26 @@
+#ifndef HANDMADE_FRAME_PACER
+#define HANDMADE_FRAME_PACER
+
+#include <stdint.h> /* uint64_t */
+
+/*
+ * Holds the frame loop to a fixed rate. frame_pacer_wait() sleeps with
+ * clock_nanosleep() until shortly before the next deadline and spins for
+ * the rest, so the CPU is idle for most of the wait without inheriting the
+ * scheduler's wake-up jitter. The spin window follows how late sleeps have
+ * actually been waking up.
+ */
+struct frame_pacer
+{
+	uint64_t period_ns; /* 0 runs uncapped */
+	uint64_t deadline_ns;
+	uint64_t spin_ns;
+	uint64_t oversleep_ns; /* moving average of wake-up lateness */
+};
+
+void frame_pacer_init(struct frame_pacer *pacer, unsigned int hz);
+
+/* blocks until the end of the current frame's period */
+void frame_pacer_wait(struct frame_pacer *pacer);
+
+#endif /* HANDMADE_FRAME_PACER */
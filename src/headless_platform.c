@@ -0,0 +1,290 @@
+/* standard library */
+#include <stdint.h>
+#include <stdio.h> /* printf, fprintf, sscanf */
+#include <stdlib.h> /* getenv, atof, strtoull */
+#include <string.h> /* strerror */
+#include <errno.h>
+#include <time.h> /* clock_nanosleep */
+
+/* system headers */
+#include <pthread.h>
+
+#include "platform.h"
+#include "engine.h"
+#include "audio_stream.h"
+#include "trace.h"
+#include "memory_arena.h"
+
+/*
+ * Runs the whole frame loop with nothing attached: frames are drawn into
+ * memory and thrown away, sound goes to a thread that consumes it like a
+ * device would, and input only comes from a recording. Useful for tracking
+ * the engine's performance on machines without a display or sound card.
+ *
+ *   game_headless [frames [input recording]]
+ *
+ * runs uncapped for the given number of frames, 600 by default, and
+ * reports throughput and the usual profile. Each frame moves the game on
+ * by a 60th of a second whatever the clock says and renders at full
+ * resolution however long it takes, so every run does the same work, and
+ * without a recording the stick is held over so every frame scrolls.
+ * HANDMADE_HEADLESS_SIZE sets the frame size (1280x720 by default),
+ * HANDMADE_RENDER_SCALE the fraction of it rendered before upscaling (1 by
+ * default) and HANDMADE_AUDIO_SPEED how fast the sink plays: 1 is real
+ * time, 2 twice as fast, 0 as fast as the frame loop can fill it.
+ */
+
+#define HEADLESS_AUDIO_PERIOD 256 /* frames the sink takes at a time */
+
+struct headless_audio
+{
+	struct audio_stream stream; /* what the engine sees */
+	double speed;
+	int quit;
+	pthread_t thread;
+};
+
+struct headless_backend
+{
+	struct platform_backend backend;
+	struct offscreen_buffer frame;
+	struct headless_audio *audio;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline)
+{
+	const struct timespec wake_time = {
+		(time_t)(deadline / 1000000000ull), (long)(deadline % 1000000000ull)
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_time, NULL) == EINTR);
+}
+
+/*
+ * Takes a period at a time off the ring. Paced, a period is due every
+ * period's worth of the sample rate, and a period that isn't all there by
+ * then counts as an underrun, the way it would on a device. Unpaced, it
+ * takes whatever there is as soon as it is there.
+ */
+static void *audio_sink_thread_driver(void *context)
+{
+	struct headless_audio *audio = context;
+	struct audio_stream *stream = &audio->stream;
+	struct ring_buffer *buffer = &stream->buffer;
+
+	const uint64_t period_ns = audio->speed > 0
+		? (uint64_t)(HEADLESS_AUDIO_PERIOD * 1e9 / (stream->rate * audio->speed))
+		: 0;
+	uint64_t deadline = 0;
+
+	printf("Starting audio sink thread\n");
+	TRACE_THREAD_NAME("audio sink");
+
+	while (!__atomic_load_n(&audio->quit, __ATOMIC_ACQUIRE)) {
+		const unsigned int available = ring_buffer_read_available(buffer);
+
+		/* the clock starts with the first frames, like a stream starting */
+		if (!available && (!period_ns || !deadline)) {
+			audio_stream_wait(stream);
+			continue;
+		}
+
+		if (period_ns) {
+			if (!deadline)
+				deadline = now_ns();
+
+			deadline += period_ns;
+			sleep_until_ns(deadline);
+		}
+
+		const unsigned int ready = ring_buffer_read_available(buffer);
+		const unsigned int frames = ready < HEADLESS_AUDIO_PERIOD ? ready : HEADLESS_AUDIO_PERIOD;
+
+		if (period_ns && frames < HEADLESS_AUDIO_PERIOD) {
+			__atomic_add_fetch(&stream->telemetry.underruns, 1, __ATOMIC_RELAXED);
+
+			/* a device would have restarted, so does the clock */
+			if (!frames)
+				deadline = 0;
+		}
+
+		ring_buffer_commit_read(buffer, frames);
+		__atomic_store_n(&stream->telemetry.ring_fill, ready - frames, __ATOMIC_RELAXED);
+	}
+
+	printf("Audio sink thread stopped\n");
+	return NULL;
+}
+
+static int headless_start(struct platform_backend *backend, struct memory_arena *arena)
+{
+	struct headless_backend *headless = (struct headless_backend*)backend;
+	struct offscreen_buffer *frame = &headless->frame;
+
+	frame->width = backend->max_width;
+	frame->height = backend->max_height;
+	frame->pitch = backend->max_width * 4;
+	frame->pixels = memory_arena_push_zero(arena, frame->pitch * frame->height, 64);
+
+	if (!frame->pixels) {
+		fprintf(stderr, "Unable to allocate %zux%zu frame\n", frame->width, frame->height);
+		return 0;
+	}
+
+	printf("Headless: %zux%zu frames\n", frame->width, frame->height);
+	return 1;
+}
+
+static struct audio_stream *headless_start_audio(
+	struct platform_backend *backend, struct memory_arena *arena,
+	unsigned int sample_rate, unsigned int buffer_size, unsigned int latency)
+{
+	struct headless_backend *headless = (struct headless_backend*)backend;
+	const unsigned int frame_size = 2 * sizeof(int16_t);
+
+	const size_t arena_marker = memory_arena_mark(arena);
+	struct headless_audio *audio = MEMORY_ARENA_PUSH_STRUCT(arena, struct headless_audio);
+
+	if (!audio) {
+		fprintf(stderr, "Unable to allocate space for the audio sink\n");
+		memory_arena_pop(arena, arena_marker);
+		return NULL;
+	}
+
+	/* never less than a period queued, or a paced sink underruns every time */
+	if (latency < 2 * HEADLESS_AUDIO_PERIOD)
+		latency = 2 * HEADLESS_AUDIO_PERIOD;
+
+	const int wait_timeout = 1 + (4000 * HEADLESS_AUDIO_PERIOD) / sample_rate;
+
+	if (!audio_stream_init(&audio->stream, buffer_size, frame_size,
+			sample_rate, latency, wait_timeout)) {
+		fprintf(stderr, "Unable to create audio ring: %s\n", strerror(errno));
+		memory_arena_pop(arena, arena_marker);
+		return NULL;
+	}
+
+	const char *speed = getenv("HANDMADE_AUDIO_SPEED");
+	audio->speed = speed ? atof(speed) : 1.0;
+
+	const int status = pthread_create(&audio->thread, NULL, audio_sink_thread_driver, audio);
+	if (status) {
+		fprintf(stderr, "Unable to create audio sink thread: %s\n", strerror(status));
+		audio_stream_destroy(&audio->stream);
+		memory_arena_pop(arena, arena_marker);
+		return NULL;
+	}
+
+	headless->audio = audio;
+	return &audio->stream;
+}
+
+/* nothing live, a recording replaces this if there is one */
+static int headless_poll_input(struct platform_backend *backend, struct input_frame *input)
+{
+	(void)backend;
+
+	/* one pad with the stick held over so every frame scrolls and has to be redrawn */
+	input->controllers[0].connected = 1;
+	input->controllers[0].stick_x = 1.0f;
+	input->controllers[0].stick_y = 0.5f;
+	return 1;
+}
+
+static struct offscreen_buffer *headless_acquire_backbuffer(struct platform_backend *backend)
+{
+	struct headless_backend *headless = (struct headless_backend*)backend;
+
+	/* one buffer, it always holds the last frame */
+	headless->frame.dirty_count = 0;
+	return &headless->frame;
+}
+
+static void headless_present(struct platform_backend *backend)
+{
+	(void)backend;
+}
+
+static void headless_stop(struct platform_backend *backend)
+{
+	struct headless_backend *headless = (struct headless_backend*)backend;
+	struct headless_audio *audio = headless->audio;
+
+	if (!audio)
+		return;
+
+	__atomic_store_n(&audio->quit, 1, __ATOMIC_RELEASE);
+
+	waker_wake(&audio->stream.wake);
+
+	pthread_join(audio->thread, NULL);
+	audio_stream_destroy(&audio->stream);
+}
+
+int main(int argc, char **argv)
+{
+	static struct headless_backend headless = {
+		.backend = {
+			.name = "headless",
+			.start = headless_start,
+			.start_audio = headless_start_audio,
+			.poll_input = headless_poll_input,
+			.acquire_backbuffer = headless_acquire_backbuffer,
+			.present = headless_present,
+			.stop = headless_stop,
+		},
+	};
+
+	unsigned int width = 1280;
+	unsigned int height = 720;
+
+	const char *size = getenv("HANDMADE_HEADLESS_SIZE");
+	if (size && (sscanf(size, "%ux%u", &width, &height) != 2 || !width || !height)) {
+		fprintf(stderr, "HANDMADE_HEADLESS_SIZE should look like 1280x720\n");
+		return -1;
+	}
+
+	/* a pinned scale keeps the work per frame the same on every machine */
+	float render_scale = 1.0f;
+
+	const char *scale = getenv("HANDMADE_RENDER_SCALE");
+	if (scale && (sscanf(scale, "%f", &render_scale) != 1 || render_scale <= 0.0f || render_scale > 1.0f)) {
+		fprintf(stderr, "HANDMADE_RENDER_SCALE should be between 0 and 1\n");
+		return -1;
+	}
+
+	/* 0 would mean no limit, which is never what a benchmark run wants */
+	unsigned long long frame_limit = 600;
+
+	if (argc > 1) {
+		char *end;
+		errno = 0;
+		frame_limit = strtoull(argv[1], &end, 10);
+
+		if (argv[1][0] < '0' || argv[1][0] > '9' || *end || errno || !frame_limit) {
+			fprintf(stderr, "usage: %s [frames [input recording]]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	headless.backend.max_width = width;
+	headless.backend.max_height = height;
+	headless.backend.storage_size = (size_t)width * height * 4;
+
+	const struct engine_options options = {
+		.target_fps = 0,
+		.frame_limit = frame_limit,
+		.frame_ns = 1000000000 / 60,
+		.replay_file = argc > 2 ? argv[2] : NULL,
+		.render_scale = render_scale,
+	};
+
+	return engine_run(&headless.backend, &options);
+}
@@ -0,0 +1,147 @@
+/* standard library */
+#include <string.h> /* memcmp, memset, strerror */
+#include <errno.h>
+
+#include "input_recording.h"
+
+static const char magic[4] = { 'H', 'M', 'I', 'R' };
+static const uint32_t version = 2;
+
+/* bytes written for each connected controller */
+#define INPUT_CONTROLLER_SIZE (4 + 4 + 1)
+
+static void reset(struct input_recording *recording)
+{
+	memset(recording, 0, sizeof(*recording));
+}
+
+int input_recording_record(struct input_recording *recording, const char *path)
+{
+	reset(recording);
+
+	recording->file = fopen(path, "wb");
+	if (!recording->file) {
+		fprintf(stderr, "Unable to open input recording %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	fwrite(magic, sizeof(magic), 1, recording->file);
+	fwrite(&version, sizeof(version), 1, recording->file);
+
+	recording->mode = INPUT_RECORDING_RECORD;
+	return 1;
+}
+
+int input_recording_replay(struct input_recording *recording, const char *path)
+{
+	char file_magic[sizeof(magic)];
+	uint32_t file_version;
+
+	reset(recording);
+
+	recording->file = fopen(path, "rb");
+	if (!recording->file) {
+		fprintf(stderr, "Unable to open input recording %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	if (fread(file_magic, sizeof(file_magic), 1, recording->file) != 1
+			|| fread(&file_version, sizeof(file_version), 1, recording->file) != 1
+			|| memcmp(file_magic, magic, sizeof(magic))
+			|| file_version != version) {
+		fprintf(stderr, "%s is not an input recording this build can replay\n", path);
+		fclose(recording->file);
+		reset(recording);
+		return 0;
+	}
+
+	recording->mode = INPUT_RECORDING_REPLAY;
+	return 1;
+}
+
+void input_recording_write(struct input_recording *recording, const struct input_frame *frame)
+{
+	if (recording->mode != INPUT_RECORDING_RECORD)
+		return;
+
+	FILE *file = recording->file;
+
+	uint8_t connected = 0;
+	for (int i = 0; i < INPUT_MAX_CONTROLLERS; ++i)
+		connected |= (frame->controllers[i].connected ? 1 : 0) << i;
+
+	fwrite(&frame->frame_ns, sizeof(frame->frame_ns), 1, file);
+	fwrite(&connected, sizeof(connected), 1, file);
+
+	for (int i = 0; i < INPUT_MAX_CONTROLLERS; ++i) {
+		const struct input_controller *controller = &frame->controllers[i];
+
+		if (!controller->connected)
+			continue;
+
+		fwrite(&controller->stick_x, sizeof(controller->stick_x), 1, file);
+		fwrite(&controller->stick_y, sizeof(controller->stick_y), 1, file);
+		fwrite(&controller->buttons, sizeof(controller->buttons), 1, file);
+	}
+
+	fwrite(&frame->key_count, sizeof(frame->key_count), 1, file);
+	fwrite(frame->keys, sizeof(frame->keys[0]), frame->key_count, file);
+
+	++recording->frames;
+}
+
+int input_recording_read(struct input_recording *recording, struct input_frame *frame)
+{
+	if (recording->mode != INPUT_RECORDING_REPLAY)
+		return 0;
+
+	unsigned char header[4 + 1];
+
+	memset(frame, 0, sizeof(*frame));
+
+	/* a clean end of file is the end of the recording */
+	if (fread(header, sizeof(header), 1, recording->file) != 1)
+		return 0;
+
+	memcpy(&frame->frame_ns, header, 4);
+	const uint8_t connected = header[4];
+	int corrupt = connected >> INPUT_MAX_CONTROLLERS != 0;
+
+	for (int i = 0; i < INPUT_MAX_CONTROLLERS && !corrupt; ++i) {
+		struct input_controller *controller = &frame->controllers[i];
+		unsigned char fixed[INPUT_CONTROLLER_SIZE];
+
+		if (!(connected & (1 << i)))
+			continue;
+
+		if (fread(fixed, sizeof(fixed), 1, recording->file) != 1) {
+			corrupt = 1;
+			break;
+		}
+
+		controller->connected = 1;
+		memcpy(&controller->stick_x, fixed, 4);
+		memcpy(&controller->stick_y, fixed + 4, 4);
+		controller->buttons = fixed[8];
+	}
+
+	if (corrupt
+			|| fread(&frame->key_count, sizeof(frame->key_count), 1, recording->file) != 1
+			|| frame->key_count > INPUT_MAX_KEYS
+			|| fread(frame->keys, sizeof(frame->keys[0]), frame->key_count, recording->file) != frame->key_count) {
+		fprintf(stderr, "Input recording is truncated or corrupt at frame %llu\n",
+			(unsigned long long)recording->frames);
+		return 0;
+	}
+
+	++recording->frames;
+	return 1;
+}
+
+void input_recording_close(struct input_recording *recording)
+{
+	if (recording->file)
+		fclose(recording->file);
+
+	reset(recording);
+}
@@ -0,0 +1,72 @@
+#ifndef HANDMADE_INPUT_RECORDING
+#define HANDMADE_INPUT_RECORDING
+
+#include <stdint.h> /* uint32_t */
+#include <stdio.h> /* FILE */
+
+/*
+ * Records everything the frame loop reads from the outside world, one
+ * input_frame per frame, so a run can be played back exactly for
+ * benchmarking and profiling.
+ *
+ * The file is a small header followed by one variable length record per
+ * frame, in native byte order:
+ *
+ *   uint32_t frame_ns     wall clock time the frame advanced the game by
+ *   uint8_t  connected    bit per controller slot
+ *   then for every connected slot, lowest first:
+ *     float    stick_x
+ *     float    stick_y
+ *     uint8_t  buttons    INPUT_BUTTON_* bits
+ *   uint8_t  key_count
+ *   uint32_t keys[]       keysyms pressed this frame
+ */
+
+#define INPUT_MAX_KEYS 16
+#define INPUT_MAX_CONTROLLERS 4
+
+#define INPUT_BUTTON_A (1 << 0)
+#define INPUT_BUTTON_B (1 << 1)
+
+struct input_controller
+{
+	uint8_t connected;
+	uint8_t buttons;
+	float stick_x;
+	float stick_y;
+};
+
+struct input_frame
+{
+	uint32_t frame_ns;
+	struct input_controller controllers[INPUT_MAX_CONTROLLERS];
+	uint8_t key_count;
+	uint32_t keys[INPUT_MAX_KEYS];
+};
+
+enum input_recording_mode
+{
+	INPUT_RECORDING_OFF,
+	INPUT_RECORDING_RECORD,
+	INPUT_RECORDING_REPLAY,
+};
+
+struct input_recording
+{
+	enum input_recording_mode mode;
+	FILE *file;
+	uint64_t frames;
+};
+
+int input_recording_record(struct input_recording *recording, const char *path);
+int input_recording_replay(struct input_recording *recording, const char *path);
+
+/* appends a frame while recording */
+void input_recording_write(struct input_recording *recording, const struct input_frame *frame);
+
+/* next frame while replaying, returns 0 once the recording has run out */
+int input_recording_read(struct input_recording *recording, struct input_frame *frame);
+
+void input_recording_close(struct input_recording *recording);
+
+#endif /* HANDMADE_INPUT_RECORDING */
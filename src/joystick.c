@@ -0,0 +1,269 @@
+/* standard library */
+#include <stdio.h> /* printf, fprintf */
+#include <string.h> /* memset, strcmp, strstr, strerror */
+#include <errno.h>
+
+/* system headers */
+#include <fcntl.h> /* open() */
+#include <unistd.h> /* read(), close() */
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/joystick.h>
+#include <libudev.h>
+
+#include "joystick.h"
+
+/* joystick events taken per read() */
+#define JOYSTICK_EVENT_BATCH 64
+
+static int is_joystick_node(const char *device_node)
+{
+	return device_node && strstr(device_node, "/js");
+}
+
+static int find_device(const struct joysticks *joysticks, const char *device_node)
+{
+	for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+		if (joysticks->devices[i].file_descriptor >= 0
+				&& !strcmp(joysticks->devices[i].device_node, device_node))
+			return i;
+	}
+
+	return -1;
+}
+
+static void add_device(struct joysticks *joysticks, const char *device_node)
+{
+	if (find_device(joysticks, device_node) >= 0)
+		return;
+
+	int slot = 0;
+	while (slot < MAX_CONTROLLERS && joysticks->devices[slot].file_descriptor >= 0)
+		++slot;
+
+	if (slot == MAX_CONTROLLERS) {
+		fprintf(stderr, "Ignoring %s, all %d controller slots are in use\n", device_node, MAX_CONTROLLERS);
+		return;
+	}
+
+	const int file_descriptor = open(device_node, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (file_descriptor < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", device_node, strerror(errno));
+		return;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u64 = joysticks->first_source + 1 + slot;
+
+	if (epoll_ctl(joysticks->epoll_fd, EPOLL_CTL_ADD, file_descriptor, &event) < 0) {
+		fprintf(stderr, "Unable to watch %s: %s\n", device_node, strerror(errno));
+		close(file_descriptor);
+		return;
+	}
+
+	struct joystick_device *device = &joysticks->devices[slot];
+	struct controller_state *controller = &joysticks->state.controllers[slot];
+
+	device->file_descriptor = file_descriptor;
+	snprintf(device->device_node, sizeof(device->device_node), "%s", device_node);
+
+	unsigned char axis_count = 0, button_count = 0;
+	ioctl(file_descriptor, JSIOCGAXES, &axis_count);
+	ioctl(file_descriptor, JSIOCGBUTTONS, &button_count);
+
+	memset(controller, 0, sizeof(*controller));
+	controller->axis_count = axis_count < CONTROLLER_MAX_AXES ? axis_count : CONTROLLER_MAX_AXES;
+	controller->button_count = button_count < CONTROLLER_MAX_BUTTONS ? button_count : CONTROLLER_MAX_BUTTONS;
+	controller->connected = 1;
+
+	printf("Controller %d connected: %s (%u axes, %u buttons)\n",
+		slot, device_node, axis_count, button_count);
+}
+
+static void remove_device(struct joysticks *joysticks, int slot)
+{
+	struct joystick_device *device = &joysticks->devices[slot];
+
+	epoll_ctl(joysticks->epoll_fd, EPOLL_CTL_DEL, device->file_descriptor, NULL);
+	close(device->file_descriptor);
+	device->file_descriptor = -1;
+
+	memset(&joysticks->state.controllers[slot], 0, sizeof(struct controller_state));
+
+	printf("Controller %d disconnected: %s\n", slot, device->device_node);
+}
+
+/*
+ * Drains everything queued on a device, a batch of events per syscall.
+ * Returns 0 once the device has gone away.
+ */
+static int read_device(struct joysticks *joysticks, int slot)
+{
+	struct js_event events[JOYSTICK_EVENT_BATCH];
+	struct controller_state *controller = &joysticks->state.controllers[slot];
+	const int file_descriptor = joysticks->devices[slot].file_descriptor;
+	ssize_t result;
+
+	do {
+		result = read(file_descriptor, events, sizeof(events));
+
+		if (result < 0)
+			return errno == EAGAIN || errno == EINTR;
+
+		if (result == 0)
+			return 0;
+
+		const int event_count = result / sizeof(struct js_event);
+
+		for (int i = 0; i < event_count; ++i) {
+			const struct js_event *event = &events[i];
+
+			switch (event->type & ~JS_EVENT_INIT) {
+				case JS_EVENT_AXIS:
+					if (event->number < CONTROLLER_MAX_AXES)
+						controller->axes[event->number] = event->value;
+					break;
+
+				case JS_EVENT_BUTTON:
+					if (event->number < CONTROLLER_MAX_BUTTONS) {
+						const uint32_t bit = (uint32_t)1 << event->number;
+						controller->buttons = event->value
+							? controller->buttons | bit
+							: controller->buttons & ~bit;
+					}
+					break;
+			}
+		}
+
+		/* a short read means the queue is empty, no need to go back for EAGAIN */
+	} while (result == sizeof(events));
+
+	return 1;
+}
+
+static void update_monitor(struct joysticks *joysticks)
+{
+	struct udev_device *device;
+
+	while ((device = udev_monitor_receive_device(joysticks->monitor))) {
+		const char *device_node = udev_device_get_devnode(device);
+		const char *action = udev_device_get_action(device);
+
+		if (is_joystick_node(device_node) && action) {
+			if (!strcmp(action, "add")) {
+				add_device(joysticks, device_node);
+			} else if (!strcmp(action, "remove")) {
+				const int slot = find_device(joysticks, device_node);
+				if (slot >= 0)
+					remove_device(joysticks, slot);
+			}
+		}
+
+		udev_device_unref(device);
+	}
+}
+
+static struct udev_monitor *create_monitor(struct udev *udev)
+{
+	struct udev_monitor *monitor = udev_monitor_new_from_netlink(udev, "udev");
+
+	if (!monitor) {
+		fputs("Unable to create udev monitor\n", stderr);
+		return NULL;
+	}
+
+	if (udev_monitor_filter_add_match_subsystem_devtype(monitor, "input", NULL) < 0
+			|| udev_monitor_enable_receiving(monitor) < 0) {
+		fputs("Unable to create udev monitor\n", stderr);
+		udev_monitor_unref(monitor);
+		return NULL;
+	}
+
+	return monitor;
+}
+
+int joysticks_init(struct joysticks *joysticks, int epoll_fd, uint64_t first_source)
+{
+	memset(joysticks, 0, sizeof(*joysticks));
+	joysticks->epoll_fd = epoll_fd;
+	joysticks->first_source = first_source;
+
+	for (int i = 0; i < MAX_CONTROLLERS; ++i)
+		joysticks->devices[i].file_descriptor = -1;
+
+	joysticks->udev = udev_new();
+	if (!joysticks->udev) {
+		fputs("Unable to connect to udev, no controllers\n", stderr);
+		return 0;
+	}
+
+	/* start listening before scanning so nothing plugged in between is missed */
+	joysticks->monitor = create_monitor(joysticks->udev);
+	if (joysticks->monitor) {
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u64 = first_source;
+
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udev_monitor_get_fd(joysticks->monitor), &event) < 0) {
+			fprintf(stderr, "Unable to watch udev monitor: %s\n", strerror(errno));
+			udev_monitor_unref(joysticks->monitor);
+			joysticks->monitor = NULL;
+		}
+	}
+
+	struct udev_enumerate *enumerate = udev_enumerate_new(joysticks->udev);
+	struct udev_list_entry *device_list, *device_list_entry;
+
+	udev_enumerate_add_match_subsystem(enumerate, "input");
+	udev_enumerate_scan_devices(enumerate);
+	device_list = udev_enumerate_get_list_entry(enumerate);
+
+	udev_list_entry_foreach(device_list_entry, device_list) {
+		const char *system_path = udev_list_entry_get_name(device_list_entry);
+		struct udev_device *device = udev_device_new_from_syspath(joysticks->udev, system_path);
+
+		if (!device)
+			continue;
+
+		const char *device_node = udev_device_get_devnode(device);
+		if (is_joystick_node(device_node))
+			add_device(joysticks, device_node);
+
+		udev_device_unref(device);
+	}
+
+	udev_enumerate_unref(enumerate);
+	return 1;
+}
+
+void joysticks_destroy(struct joysticks *joysticks)
+{
+	for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+		if (joysticks->devices[i].file_descriptor >= 0)
+			remove_device(joysticks, i);
+	}
+
+	if (joysticks->monitor)
+		udev_monitor_unref(joysticks->monitor);
+
+	if (joysticks->udev)
+		udev_unref(joysticks->udev);
+}
+
+void joysticks_update(struct joysticks *joysticks, uint64_t source)
+{
+	if (source == joysticks->first_source) {
+		update_monitor(joysticks);
+		return;
+	}
+
+	const int slot = source - joysticks->first_source - 1;
+
+	/* events for a slot removed earlier in the same batch */
+	if (joysticks->devices[slot].file_descriptor < 0)
+		return;
+
+	if (!read_device(joysticks, slot))
+		remove_device(joysticks, slot);
+}
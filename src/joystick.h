@@ -0,0 +1,81 @@
+#ifndef HANDMADE_JOYSTICK
+#define HANDMADE_JOYSTICK
+
+#include <stdint.h> /* int16_t, uint32_t, uint64_t */
+
+/*
+ * Controllers on the Linux joystick interface (/dev/input/js*).
+ *
+ * Devices found at startup and plugged in later through the udev monitor
+ * are given a fixed slot. Each slot's state is one cache line, and all of
+ * them together make a flat array the frame loop copies in one go, so a
+ * frame costs the same however many controllers are connected. Devices are
+ * only read when epoll reports them readable.
+ */
+
+#define MAX_CONTROLLERS 4
+#define CONTROLLER_MAX_AXES 16
+#define CONTROLLER_MAX_BUTTONS 32
+
+struct controller_state
+{
+	int16_t axes[CONTROLLER_MAX_AXES]; /* raw, -32767 to 32767 */
+	uint32_t buttons; /* bit per button, set while held */
+	uint8_t axis_count;
+	uint8_t button_count;
+	uint8_t connected;
+} __attribute__((aligned(64)));
+
+/* what every controller looked like at one point in a frame */
+struct controller_snapshot
+{
+	struct controller_state controllers[MAX_CONTROLLERS];
+};
+
+struct joystick_device
+{
+	int file_descriptor; /* -1 while the slot is free */
+	char device_node[64];
+};
+
+struct joysticks
+{
+	int epoll_fd;
+	uint64_t first_source;
+
+	struct udev *udev;
+	struct udev_monitor *monitor;
+
+	struct joystick_device devices[MAX_CONTROLLERS];
+	struct controller_snapshot state;
+};
+
+/*
+ * Opens every joystick present and starts watching for hotplug. The
+ * monitor is added to epoll_fd as event source first_source and the
+ * controller in slot i as first_source + 1 + i.
+ */
+int joysticks_init(struct joysticks *joysticks, int epoll_fd, uint64_t first_source);
+void joysticks_destroy(struct joysticks *joysticks);
+
+/* true for the epoll event sources joysticks_init() registered */
+static inline int joysticks_owns_source(const struct joysticks *joysticks, uint64_t source)
+{
+	return source >= joysticks->first_source
+		&& source <= joysticks->first_source + MAX_CONTROLLERS;
+}
+
+/* handles readiness on one of those sources */
+void joysticks_update(struct joysticks *joysticks, uint64_t source);
+
+static inline float controller_axis(const struct controller_state *controller, unsigned int axis)
+{
+	return controller->axes[axis] / 32767.0f;
+}
+
+static inline int controller_button(const struct controller_state *controller, unsigned int button)
+{
+	return (controller->buttons >> button) & 1;
+}
+
+#endif /* HANDMADE_JOYSTICK */
@@ -0,0 +1,100 @@
+#include <string.h> /* memset */
+
+#include "latency_controller.h"
+
+static inline unsigned int min_uint(unsigned int x, unsigned int y)
+{
+	return x < y ? x : y;
+}
+
+static inline unsigned int max_uint(unsigned int x, unsigned int y)
+{
+	return x > y ? x : y;
+}
+
+static void reset_window(struct latency_controller *controller)
+{
+	controller->window_elapsed = 0;
+	controller->window_underruns = 0;
+	controller->window_min_queued = (unsigned int)-1;
+}
+
+void latency_controller_init(
+	struct latency_controller *controller,
+	unsigned int initial, unsigned int min_latency, unsigned int max_latency,
+	unsigned int margin, unsigned int window_frames)
+{
+	memset(controller, 0, sizeof(*controller));
+
+	controller->min_latency = min_latency;
+	controller->max_latency = max_latency;
+	controller->margin = margin;
+	controller->window_frames = window_frames ? window_frames : 1;
+	controller->target = max_uint(min_latency, min_uint(initial, max_latency));
+
+	reset_window(controller);
+}
+
+unsigned int latency_controller_underrun(struct latency_controller *controller)
+{
+	const unsigned int raise = max_uint(controller->target / 2, controller->margin);
+
+	controller->target = min_uint(controller->target + raise, controller->max_latency);
+	++controller->window_underruns;
+
+	/* the windows before the underrun no longer say anything about
+	 * whether the new target is safe */
+	controller->history_count = 0;
+
+	return controller->target;
+}
+
+/* lowers the target if the whole history is clean and had room to spare */
+static void close_window(struct latency_controller *controller)
+{
+	const unsigned int index = controller->history_index;
+
+	controller->history_underruns[index] = controller->window_underruns;
+	controller->history_min_queued[index] = controller->window_min_queued;
+	controller->history_index = (index + 1) % LATENCY_HISTORY;
+	if (controller->history_count < LATENCY_HISTORY)
+		++controller->history_count;
+
+	reset_window(controller);
+
+	if (controller->history_count < LATENCY_HISTORY)
+		return;
+
+	unsigned int min_queued = (unsigned int)-1;
+	for (int i = 0; i < LATENCY_HISTORY; ++i) {
+		if (controller->history_underruns[i])
+			return;
+		min_queued = min_uint(min_queued, controller->history_min_queued[i]);
+	}
+
+	const unsigned int step = max_uint(controller->target / 16, 1);
+
+	if (controller->target - step < controller->min_latency)
+		return;
+
+	if (min_queued < controller->margin + step)
+		return;
+
+	controller->target -= step;
+
+	/* gather a full history at the new target before the next cut */
+	controller->history_count = 0;
+}
+
+unsigned int latency_controller_update(
+	struct latency_controller *controller,
+	unsigned int frames_elapsed, unsigned int queued)
+{
+	controller->window_min_queued = min_uint(controller->window_min_queued, queued);
+	controller->window_elapsed += frames_elapsed;
+
+	if (controller->window_elapsed >= controller->window_frames)
+		close_window(controller);
+
+	return controller->target;
+}
@@ -0,0 +1,47 @@
+#ifndef HANDMADE_LATENCY_CONTROLLER
+#define HANDMADE_LATENCY_CONTROLLER
+
+/*
+ * Picks how far ahead of the audio device the game should write.
+ *
+ * Every underrun raises the target by half straight away. Lowering is slow:
+ * the controller keeps a sliding history of the last LATENCY_HISTORY windows
+ * and only once all of them at the current target passed without an
+ * underrun, and the least audio queued in them (ring fill + device delay)
+ * would still leave a margin after the cut, is the target lowered by a
+ * sixteenth. So one hitch costs latency for a while rather than for the
+ * rest of the session.
+ */
+
+#define LATENCY_HISTORY 8 /* windows kept */
+
+struct latency_controller
+{
+	unsigned int target; /* frames */
+	unsigned int min_latency;
+	unsigned int max_latency;
+	unsigned int margin; /* frames that must stay queued after a cut */
+
+	unsigned int window_frames; /* length of one window */
+	unsigned int window_elapsed;
+	unsigned int window_underruns;
+	unsigned int window_min_queued;
+
+	unsigned int history_underruns[LATENCY_HISTORY];
+	unsigned int history_min_queued[LATENCY_HISTORY];
+	unsigned int history_index;
+	unsigned int history_count;
+};
+
+void latency_controller_init(
+	struct latency_controller *controller,
+	unsigned int initial, unsigned int min_latency, unsigned int max_latency,
+	unsigned int margin, unsigned int window_frames);
+
+/* both return the new target latency */
+unsigned int latency_controller_underrun(struct latency_controller *controller);
+unsigned int latency_controller_update(
+	struct latency_controller *controller,
+	unsigned int frames_elapsed, unsigned int queued);
+
+#endif /* HANDMADE_LATENCY_CONTROLLER */
@@ -5,11 +5,9 @@
 #include <time.h>
 
 /* system headers */
-#include <sys/mman.h>
-#include <linux/joystick.h>
 #include <fcntl.h> /* open() */
 #include <unistd.h> /* read() */
-#include <libudev.h>
+#include <sys/epoll.h>
 #include <pthread.h>
 
 /* X11 headers */
@@ -23,257 +21,622 @@
 #include <alsa/asoundlib.h>
 
 #include "platform.h"
+#include "engine.h"
+#include "audio_stream.h"
+#include "ring_buffer.h"
+#include "waker.h"
+#include "latency_controller.h"
+#include "trace.h"
+#include "memory_arena.h"
+#include "input_recording.h"
+#include "joystick.h"
 
 #define USE_MIT_SHM
 #define MIN(x, y) (x) < (y) ? (x) : (y)
 
-struct joystick
+/*
+ * Presentation
+ *
+ * Frames are put on the window by a thread of its own with its own X
+ * connection, so the main loop never waits on the server: it hands each
+ * finished buffer over through a lock-free queue and carries on.
+ *
+ * With MIT-SHM the server copies frames straight out of shared memory, so
+ * there are a few of them: the game draws into one while the server is
+ * still reading the ones presented before it. A ShmCompletion event says
+ * when the server is done with a buffer and it can be drawn into again.
+ * Without it the present thread copies a buffer into the request and gives
+ * it straight back, but there are still two so one can be drawn while the
+ * other is in the queue.
+ *
+ * Every buffer is big enough for the whole screen, so a window resize only
+ * changes how much of them is used and never has to wait for the server
+ * to let go of them.
+ */
+#ifdef USE_MIT_SHM
+#define PRESENT_BUFFER_COUNT 3
+#else
+#define PRESENT_BUFFER_COUNT 2
+#endif
+
+struct present_buffer
 {
-	const char *device_node;
-	const char *system_path;
-	int file_descriptor;
+	XImage *ximage;
+#ifdef USE_MIT_SHM
+	XShmSegmentInfo shm;
+#endif
+	struct offscreen_buffer pixels;
+
+	/* set by the main thread when it hands the buffer over, cleared by the
+	 * present thread once the server is done with it */
+	int busy;
+	int present_x; /* where in the window, fixed when it is handed over */
+	int present_y;
+
+	/* changed in other buffers since this one was drawn, copied across
+	 * before it is drawn into again */
+	unsigned int stale_count;
+	struct dirty_rect stale[OFFSCREEN_MAX_DIRTY_RECTS];
 };
 
-static struct joystick *joysticks;
+struct present_thread
+{
+	Display *display; /* used by the present thread only once it is running */
+	GC gc;
+	int shm_completion_event;
+	struct waker wake; /* the main thread signals it after queueing a buffer */
+	int quit;
+	pthread_t thread;
+
+	/* indices of buffers to present, main thread produces */
+	struct ring_buffer queue;
+	unsigned int queue_data[PRESENT_BUFFER_COUNT + 1];
+};
 
 struct x11_device
 {
-	XImage *ximage;
-	XShmSegmentInfo *shm;
+	struct present_buffer buffers[PRESENT_BUFFER_COUNT];
+	unsigned int current_buffer; /* the next one drawn and presented */
+	int latest_buffer; /* the last one presented, -1 before the first */
+	int full_present; /* the window lost its contents, send everything */
+
+	/* window size from the last ConfigureNotify, and the image centred in it */
+	unsigned int window_width;
+	unsigned int window_height;
+	unsigned int width;
+	unsigned int height;
+	int present_x;
+	int present_y;
+	unsigned int max_width; /* the screen, no window gets a bigger image */
+	unsigned int max_height;
+
 	XVisualInfo vinfo;
-	struct offscreen_buffer backbuffer;
-	Display *display;
+	Display *display; /* events, main thread only */
 	Window window;
-	GC gc;
 	int root;
 	int screen;
+
+	struct present_thread present;
 };
 
-static void destroy_shm(struct x11_device *device)
+static void destroy_buffers(struct x11_device *device)
 {
+	for (int i = 0; i < PRESENT_BUFFER_COUNT; ++i) {
+		struct present_buffer *buffer = &device->buffers[i];
+
+		if (!buffer->ximage)
+			continue;
+
 #ifdef USE_MIT_SHM
-	if (device->shm) {
-		XShmDetach(device->display, device->shm);
-		XDestroyImage(device->ximage);
-		shmdt(device->shm->shmaddr);
-		shmctl(device->shm->shmid, IPC_RMID, 0);
-	}
+		/* the segment was marked for removal once attached, so this frees it */
+		XShmDetach(device->present.display, &buffer->shm);
+		XDestroyImage(buffer->ximage);
+		shmdt(buffer->shm.shmaddr);
+#else
+		/* the pixels belong to the arena, not Xlib */
+		buffer->ximage->data = NULL;
+		XDestroyImage(buffer->ximage);
 #endif
+		buffer->ximage = NULL;
+	}
 }
 
-static void resize_ximage(
-	struct x11_device *device,
-	unsigned int width, unsigned int height)
+/* screen sized images on the present connection, made before its thread starts */
+static void create_buffers(struct x11_device *device, struct memory_arena *arena)
 {
-	if (device->backbuffer.width == width && device->backbuffer.height == height)
-		return;
+	Display *display = device->present.display;
+	const unsigned int width = device->max_width;
+	const unsigned int height = device->max_height;
+
+	for (int i = 0; i < PRESENT_BUFFER_COUNT; ++i) {
+		struct present_buffer *buffer = &device->buffers[i];
+
+#ifdef USE_MIT_SHM
+		(void)arena;
+
+		buffer->ximage = XShmCreateImage(
+			display,
+			device->vinfo.visual,
+			device->vinfo.depth,
+			ZPixmap,
+			NULL,
+			&buffer->shm,
+			width,
+			height);
+
+		assert(buffer->ximage);
+
+		const size_t size = buffer->ximage->bytes_per_line * height;
+
+		buffer->shm.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT|0777);
+		buffer->shm.shmaddr = buffer->ximage->data = shmat(buffer->shm.shmid, 0, 0);
+		memset(buffer->shm.shmaddr, 255, size);
+
+		buffer->shm.readOnly = False;
+		XShmAttach(display, &buffer->shm);
+
+		buffer->pixels.pixels = buffer->shm.shmaddr;
+		buffer->pixels.pitch = buffer->ximage->bytes_per_line;
+#else
+		buffer->pixels.pitch = width * 4;
+		buffer->pixels.pixels = memory_arena_push(arena, buffer->pixels.pitch * height, 64);
+		assert(buffer->pixels.pixels);
+
+		buffer->ximage = XCreateImage(
+			display,
+			device->vinfo.visual,
+			device->vinfo.depth,
+			ZPixmap,
+			0,
+			buffer->pixels.pixels,
+			width,
+			height,
+			32,
+			buffer->pixels.pitch);
+
+		assert(buffer->ximage);
+#endif
+		/* sized to the window when first acquired */
+		buffer->pixels.width = 0;
+		buffer->pixels.height = 0;
+		buffer->pixels.dirty_count = 0;
+		buffer->stale_count = 0;
+		buffer->busy = 0;
+	}
 
 #ifdef USE_MIT_SHM
-	if (!device->shm) {
-		device->shm = malloc(sizeof(XShmSegmentInfo));
+	/* once the server has attached, the segments go away with the last detach
+	 * even if we never get to clean up */
+	XSync(display, False);
+	for (int i = 0; i < PRESENT_BUFFER_COUNT; ++i)
+		shmctl(device->buffers[i].shm.shmid, IPC_RMID, 0);
+#endif
+
+	device->current_buffer = 0;
+	device->latest_buffer = -1;
+	device->full_present = 1;
+}
+
+/* from ConfigureNotify, nothing is asked of the server */
+static void resize_window(struct x11_device *device, unsigned int width, unsigned int height)
+{
+	device->window_width = width;
+	device->window_height = height;
+	device->width = MIN(width, device->max_width);
+	device->height = MIN(height, device->max_height);
+
+	const int x = ((int)width - (int)device->width) / 2;
+	const int y = ((int)height - (int)device->height) / 2;
+
+	if (x != device->present_x || y != device->present_y) {
+		device->present_x = x;
+		device->present_y = y;
+		device->full_present = 1;
 	}
+}
 
-	if (device->ximage) {
-		destroy_shm(device);
+static void copy_rect(
+	struct offscreen_buffer *to, const struct offscreen_buffer *from,
+	const struct dirty_rect *rect)
+{
+	for (int y = rect->y; y < rect->y + rect->height; ++y) {
+		memcpy(
+			(uint8_t*)to->pixels + y * to->pitch + rect->x * 4,
+			(const uint8_t*)from->pixels + y * from->pitch + rect->x * 4,
+			rect->width * 4);
 	}
+}
 
-	device->ximage = XShmCreateImage(
-		device->display,
-		device->vinfo.visual,
-		device->vinfo.depth,
-		ZPixmap,
-		NULL,
-		device->shm,
-		width,
-		height);
+/*
+ * The buffer to draw the next frame into, holding the latest frame so the
+ * game only has to draw what changes. NULL while the present thread or the
+ * server still has it, the frame is dropped rather than waited for.
+ */
+static struct offscreen_buffer *acquire_backbuffer(struct x11_device *device)
+{
+	struct present_buffer *buffer = &device->buffers[device->current_buffer];
+
+	if (__atomic_load_n(&buffer->busy, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	const struct offscreen_buffer *latest = device->latest_buffer >= 0
+		? &device->buffers[device->latest_buffer].pixels
+		: NULL;
+
+	/* the window changed size since this one was drawn */
+	if (buffer->pixels.width != device->width || buffer->pixels.height != device->height) {
+		buffer->pixels.width = device->width;
+		buffer->pixels.height = device->height;
+		buffer->stale_count = 0;
+
+		/* nothing to catch up from if the latest frame is the old size too,
+		 * the game redraws a buffer that changes size */
+		if (latest && latest->width == device->width && latest->height == device->height) {
+			const struct dirty_rect everything = { 0, 0, device->width, device->height };
+			dirty_rect_add(buffer->stale, &buffer->stale_count,
+				device->width, device->height, everything);
+		}
+	}
+
+	if (buffer->stale_count && latest) {
+		TRACE_SCOPE("copy stale rects");
 
-	assert(device->ximage);
+		for (unsigned int i = 0; i < buffer->stale_count; ++i)
+			copy_rect(&buffer->pixels, latest, &buffer->stale[i]);
+	}
+
+	buffer->stale_count = 0;
+	buffer->pixels.dirty_count = 0;
+
+	return &buffer->pixels;
+}
+
+/* called by the main thread after queueing a buffer */
+static void notify_present(struct present_thread *present)
+{
+	waker_notify(&present->wake);
+}
+
+/* hands the current buffer to the present thread if anything in it changed */
+static void update_window(struct x11_device *device)
+{
+	TRACE_SCOPE("update_window");
 
-	device->shm->shmid = shmget(
-		IPC_PRIVATE,
-		device->ximage->bytes_per_line * height,
-		IPC_CREAT|0777);
+	struct present_buffer *buffer = &device->buffers[device->current_buffer];
+	struct offscreen_buffer *pixels = &buffer->pixels;
 
-	device->shm->shmaddr = device->ximage->data = shmat(device->shm->shmid, 0, 0);
-	memset(device->shm->shmaddr, 255, device->ximage->bytes_per_line * height);
+	/* nothing changed, keep drawing into the same buffer */
+	if (!pixels->dirty_count && !device->full_present)
+		return;
 
-	device->shm->readOnly = False;
-	XShmAttach(device->display, device->shm);
+	/* the other buffers catch up on these before they are drawn into */
+	for (int i = 0; i < PRESENT_BUFFER_COUNT; ++i) {
+		if (i == (int)device->current_buffer)
+			continue;
 
-	device->backbuffer.pixels = device->shm->shmaddr;
-	device->backbuffer.width = width;
-	device->backbuffer.height = height;
-	device->backbuffer.pitch = device->ximage->bytes_per_line;
+		struct present_buffer *other = &device->buffers[i];
+		for (unsigned int r = 0; r < pixels->dirty_count; ++r) {
+			dirty_rect_add(
+				other->stale, &other->stale_count,
+				other->pixels.width, other->pixels.height, pixels->dirty[r]);
+		}
+	}
 
+	/* the present thread sends whatever is left on the dirty list */
+	if (device->full_present) {
+		pixels->dirty_count = 0;
+		offscreen_buffer_mark_dirty(pixels, 0, 0, pixels->width, pixels->height);
+		device->full_present = 0;
+	}
+
+	buffer->present_x = device->present_x;
+	buffer->present_y = device->present_y;
+	__atomic_store_n(&buffer->busy, 1, __ATOMIC_RELAXED);
+
+	struct ring_buffer *queue = &device->present.queue;
+	*(unsigned int*)ring_buffer_frame(queue, queue->write_cursor) = device->current_buffer;
+	ring_buffer_commit_write(queue, 1);
+	notify_present(&device->present);
+
+	device->latest_buffer = device->current_buffer;
+	device->current_buffer = (device->current_buffer + 1) % PRESENT_BUFFER_COUNT;
+}
+
+static void present_buffer(struct x11_device *device, struct present_buffer *buffer)
+{
+	TRACE_SCOPE("present");
+
+	struct present_thread *present = &device->present;
+	const struct offscreen_buffer *pixels = &buffer->pixels;
+
+	for (unsigned int i = 0; i < pixels->dirty_count; ++i) {
+		const struct dirty_rect *rect = &pixels->dirty[i];
+
+#ifndef USE_MIT_SHM
+		XPutImage(
+			present->display, device->window,
+			present->gc, buffer->ximage,
+			rect->x, rect->y,
+			buffer->present_x + rect->x, buffer->present_y + rect->y,
+			rect->width,
+			rect->height);
 #else
-	const size_t new_buffer_size = width * height * 4;
+		/* one completion for the whole frame is enough */
+		XShmPutImage(
+			present->display, device->window,
+			present->gc, buffer->ximage,
+			rect->x, rect->y,
+			buffer->present_x + rect->x, buffer->present_y + rect->y,
+			rect->width,
+			rect->height,
+			i == pixels->dirty_count - 1);
+#endif
+	}
+
+#ifdef USE_MIT_SHM
+	/* the completion event gives it back, if anything was sent */
+	if (pixels->dirty_count)
+		return;
+#endif
+
+	/* Xlib has its own copy of whatever was sent */
+	__atomic_store_n(&buffer->busy, 0, __ATOMIC_RELEASE);
+}
 
-	if (device->ximage)
-		XDestroyImage(device->ximage);
+/* reads whatever the server sent without waiting for more */
+static void read_present_events(struct x11_device *device)
+{
+	struct present_thread *present = &device->present;
 
-	device->backbuffer.pixels = malloc(new_buffer_size);
-	device->backbuffer.width = width;
-	device->backbuffer.height = height;
-	device->backbuffer.pitch = bytes_per_line;
+	while (XPending(present->display)) {
+		XEvent event;
+		XNextEvent(present->display, &event);
 
+#ifdef USE_MIT_SHM
+		if (event.type == present->shm_completion_event) {
+			const XShmCompletionEvent *completion = (XShmCompletionEvent*)&event;
 
-	device->ximage = XCreateImage(
-		device->display,
-		device->vinfo.visual,
-		device->vinfo.depth,
-		ZPixmap,
-		0,
-		device->backbuffer.pixels,
-		width,
-		height,
-		32,
-		width * 4);
-
-	assert(device->ximage);
+			for (int i = 0; i < PRESENT_BUFFER_COUNT; ++i) {
+				if (device->buffers[i].shm.shmseg == completion->shmseg)
+					__atomic_store_n(&device->buffers[i].busy, 0, __ATOMIC_RELEASE);
+			}
+		}
 #endif
+	}
 }
 
-static void update_window(struct x11_device *device)
+/*
+ * Presents buffers as they are queued and sleeps on its waker and the X
+ * connection in between, so it only runs when there is a frame to send or
+ * the server has finished with one.
+ */
+static void *present_thread_driver(void *context)
 {
-	/* find out window size to centralise
-	 * image rather than resize backbuffer
-	 */
-	struct {
-		Window root;
-		int x;
-		int y;
-		unsigned int w;
-		unsigned int h;
-		unsigned int border_width;
-		unsigned int depth;
-	} winattrs;
-
-	XGetGeometry(
-		device->display, device->window,
-		&winattrs.root,
-		&winattrs.x,
-		&winattrs.y,
-		&winattrs.w,
-		&winattrs.h,
-		&winattrs.border_width,
-		&winattrs.depth);
-
-	int x = (winattrs.w - device->backbuffer.width) / 2;
-	int y = (winattrs.h - device->backbuffer.height) / 2;
-
-#ifndef USE_MIT_SHIM
-	XPutImage(
-		device->display, device->window,
-		device->gc, device->ximage,
-		0, 0,
-		x, y,
-		device->backbuffer.width,
-		device->backbuffer.height);
-#else
-	XShmPutImage(
-		device->display, device->window,
-		device->gc, device->ximage,
-		0, 0,
-		x, y,
-		device->backbuffer.width
-		device->backbuffer.height,
-		False);
-	XSync(device->display, False);
+	struct x11_device *device = context;
+	struct present_thread *present = &device->present;
+	struct ring_buffer *queue = &present->queue;
+
+	printf("Starting present thread\n");
+	TRACE_THREAD_NAME("present");
+
+	for (;;) {
+		unsigned int queued = ring_buffer_read_available(queue);
+
+		if (queued) {
+			while (queued--) {
+				const unsigned int index = *(unsigned int*)ring_buffer_frame(queue, queue->read_cursor);
+				present_buffer(device, &device->buffers[index]);
+				ring_buffer_commit_read(queue, 1);
+			}
+
+			/* no XSync, the completion event says when the buffer is free again */
+			XFlush(present->display);
+		}
+
+		read_present_events(device);
+
+		waker_begin_wait(&present->wake);
+
+		if (__atomic_load_n(&present->quit, __ATOMIC_ACQUIRE))
+			break;
+
+		/* the main thread may have queued before it could see the flag */
+		if (!ring_buffer_read_available(queue))
+			waker_wait(&present->wake, ConnectionNumber(present->display), -1);
+
+		waker_end_wait(&present->wake);
+	}
+
+	printf("Present thread stopped\n");
+	return NULL;
+}
+
+/*
+ * Opens the present thread's connection and makes the buffers on it. The
+ * window has to exist on the server already, the caller syncs its own
+ * connection first.
+ */
+static int start_present_thread(struct x11_device *device, struct memory_arena *arena)
+{
+	struct present_thread *present = &device->present;
+
+	present->display = XOpenDisplay(NULL);
+	if (!present->display) {
+		fputs("X11: Unable to create connection for presenting\n", stderr);
+		return 0;
+	}
+
+#ifdef USE_MIT_SHM
+	assert(True == XShmQueryExtension(present->display));
+	present->shm_completion_event = XShmGetEventBase(present->display) + ShmCompletion;
 #endif
+
+	present->gc = XCreateGC(present->display, device->window, 0, NULL);
+	create_buffers(device, arena);
+
+	ring_buffer_init(&present->queue, present->queue_data,
+		PRESENT_BUFFER_COUNT + 1, sizeof(present->queue_data[0]));
+
+	if (!waker_init(&present->wake)) {
+		fprintf(stderr, "Unable to create present wake eventfd: %s\n", strerror(errno));
+		return 0;
+	}
+
+	const int status = pthread_create(&present->thread, NULL, present_thread_driver, device);
+	if (status) {
+		fprintf(stderr, "Unable to create present thread: %s\n", strerror(status));
+		waker_destroy(&present->wake);
+		return 0;
+	}
+
+	return 1;
 }
 
-struct ring_buffer
+static void stop_present_thread(struct x11_device *device)
 {
-	unsigned int size;
-	unsigned int frame_size;
-	unsigned int read_cursor;
-	unsigned int write_cursor;
-	unsigned int target_latency;
-	void *data;
-};
+	struct present_thread *present = &device->present;
+
+	__atomic_store_n(&present->quit, 1, __ATOMIC_SEQ_CST);
+
+	waker_wake(&present->wake);
+	pthread_join(present->thread, NULL);
+
+	waker_destroy(&present->wake);
+	destroy_buffers(device);
+	XFreeGC(present->display, present->gc);
+	XCloseDisplay(present->display);
+}
+
+/*
+ * Audio
+ */
 
 struct alsa_context
 {
-	unsigned int rate;
+	struct audio_stream stream; /* what the engine sees */
 	unsigned int channels;
 	unsigned int periods;
 	unsigned int period_size;
+	struct latency_controller latency; /* audio thread only */
 	snd_pcm_t *pcm_handle;
-	void *play_buffer;
-	struct ring_buffer buffer;
 };
 
+/* returns 0 if the stream can't be recovered */
+static int recover_audio(struct alsa_context *context, int status)
+{
+	/* TODO(djr): logging */
+	if (status == -EPIPE) {
+		/* underrun detected, increase latency */
+		struct audio_telemetry *telemetry = &context->stream.telemetry;
+		const unsigned int latency = context->latency.target;
+		const unsigned int new_latency = latency_controller_underrun(&context->latency);
+
+		__atomic_store_n(&telemetry->target_latency, new_latency, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&telemetry->underruns, 1, __ATOMIC_RELAXED);
+		fprintf(stderr, "audio latency increased: %d -> %d\n", latency, new_latency);
+	}
+
+	status = snd_pcm_recover(context->pcm_handle, status, 0);
+
+	if (status < 0) {
+		fprintf(stderr, "alsa unable to recover: %s\n", snd_strerror(status));
+		return 0;
+	}
+
+	return 1;
+}
+
+/* feeds the controller how much audio is queued after a device write */
+static void update_latency(struct alsa_context *context, unsigned int frames_written)
+{
+	struct audio_telemetry *telemetry = &context->stream.telemetry;
+	snd_pcm_sframes_t delay;
+
+	if (snd_pcm_delay(context->pcm_handle, &delay) < 0 || delay < 0)
+		delay = 0;
+
+	const unsigned int ring_fill = ring_buffer_read_available(&context->stream.buffer);
+	const unsigned int target = latency_controller_update(
+		&context->latency, frames_written, ring_fill + delay);
+
+	__atomic_store_n(&telemetry->ring_fill, ring_fill, __ATOMIC_RELAXED);
+	__atomic_store_n(&telemetry->device_delay, (unsigned int)delay, __ATOMIC_RELAXED);
+	__atomic_store_n(&telemetry->target_latency, target, __ATOMIC_RELAXED);
+}
+
+/*
+ * Copies frames from the ring straight into the device's mmap'd buffer.
+ * The thread sleeps in snd_pcm_wait() while the device buffer is full and
+ * on the stream's waker while the ring is empty, so it only wakes when there is
+ * something to do.
+ */
 static int update_audio(struct alsa_context *context)
 {
-	struct ring_buffer *buffer = &context->buffer;
+	TRACE_SCOPE("update_audio");
 
-		const int read_cursor = buffer->read_cursor;
-		const int write_cursor = buffer->write_cursor;
+	struct ring_buffer *buffer = &context->stream.buffer;
+	snd_pcm_t *pcm_handle = context->pcm_handle;
 
-		const int cursor_diff = write_cursor - read_cursor;
-		const int buffer_size = buffer->size;
-		const unsigned int frame_size = buffer->frame_size;
-		const unsigned int frames_to_end = buffer_size - read_cursor;
-		const unsigned int period_size = context->period_size;
+	const snd_pcm_sframes_t device_available = snd_pcm_avail_update(pcm_handle);
 
-		unsigned int frames_to_write = 0;
+	if (device_available < 0)
+		return recover_audio(context, device_available);
 
-		if (cursor_diff > 0) {
-			frames_to_write = MIN((unsigned)cursor_diff, period_size);
-		} else if (cursor_diff < 0) {
-			frames_to_write = MIN(frames_to_end, period_size);
-		}
+	const unsigned int frames_available = ring_buffer_read_available(buffer);
 
-		if (frames_to_write) {
-			snd_pcm_uframes_t frames_left = frames_to_write;
-			const int16_t *play_buffer = buffer->data + (read_cursor * frame_size);;
+	if (!frames_available) {
+		audio_stream_wait(&context->stream);
+		return 1;
+	}
 
-			while (frames_left > 0) {
-				int status;
+	const snd_pcm_state_t state = snd_pcm_state(pcm_handle);
 
-				status = snd_pcm_writei(
-					context->pcm_handle,
-					play_buffer,
-					frames_left);
+	if ((snd_pcm_uframes_t)device_available < context->period_size
+			&& state == SND_PCM_STATE_RUNNING) {
+		const int status = snd_pcm_wait(pcm_handle, context->stream.wait_timeout);
+		return status < 0 ? recover_audio(context, status) : 1;
+	}
 
+	const unsigned int frame_size = buffer->frame_size;
+	const unsigned int frames_to_write = MIN(frames_available, (unsigned int)device_available);
+	unsigned int frames_left = frames_to_write;
 
-				/* TODO(djr): logging */
-				if (status < 0) {
-					if (status == -EAGAIN) {
-						const struct timespec delay = { 0, 1000L }; /* 1ms */
-						nanosleep(&delay, NULL);
-						continue;
-					}
+	while (frames_left > 0) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames = frames_left;
 
-					if (status == -EPIPE) {
-						/* underrun detected, increase latency and silence play_buffer */
-						const unsigned int latency = buffer->target_latency;
-						buffer->target_latency += latency / 10;
-						fprintf(stderr, "audio latency increased: %d -> %d\n", latency, buffer->target_latency);
-					}
+		int status = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &frames);
+		if (status < 0)
+			return recover_audio(context, status);
 
-					status = snd_pcm_recover(context->pcm_handle, status, 0);
+		/* interleaved, so every channel shares the first area */
+		uint8_t *device_frames = (uint8_t*)areas[0].addr
+			+ areas[0].first / 8 + offset * (areas[0].step / 8);
 
-					if (status < 0) {
-						fprintf(stderr, "alsa unable to recover\n");
-						return 0; /* kill audio thread */
-					}
+		/* mirrored, so the frames are contiguous across the wrap */
+		memcpy(device_frames, ring_buffer_frame(buffer, buffer->read_cursor), frames * frame_size);
 
-					/* successfully recovered */
-					continue;
-				}
+		const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm_handle, offset, frames);
+		if (committed < 0)
+			return recover_audio(context, committed);
 
-				play_buffer += status * frame_size;
-				frames_left -= status;
-			}
+		/* a short commit still took its frames, the rest go next time */
+		ring_buffer_commit_read(buffer, committed);
+		frames_left -= committed;
 
+		if ((snd_pcm_uframes_t)committed != frames)
+			break;
+	}
 
-		} else {
-			const struct timespec delay = { 0, 16000L }; /* 16ms */
-			nanosleep(&delay, NULL);
-		}
+	/* mmap writes don't start the stream on their own */
+	if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+		const int status = snd_pcm_start(pcm_handle);
+		if (status < 0)
+			return recover_audio(context, status);
+	}
 
-		buffer->read_cursor = (read_cursor + frames_to_write) % buffer_size;
+	update_latency(context, frames_to_write - frames_left);
 
 	return 1;
 }
@@ -281,6 +644,7 @@ static int update_audio(struct alsa_context *context)
 static void *update_audio_thread_driver(void *context)
 {
 	printf("Starting audio thread\n");
+	TRACE_THREAD_NAME("audio");
 	while (update_audio(context));
 	printf("Audio thread stopped\n");
 	return NULL;
@@ -295,12 +659,14 @@ static void *update_audio_thread_driver(void *context)
  * Period Size: How many frames that are sent in a single batch
  * Periods:		How many batches of frames that alsa processes in one go
  */
-static struct ring_buffer *init_audio(
+static struct alsa_context *init_audio(
+	struct memory_arena *arena,
 	unsigned int sample_rate, unsigned int buffer_size, unsigned int latency)
 {
 	int status;
 	snd_pcm_t *pcm_handle;
 	snd_pcm_hw_params_t *hw_params;
+	snd_pcm_sw_params_t *sw_params;
 	struct alsa_context *context;
 
 	const unsigned int rate = sample_rate;
@@ -309,17 +675,21 @@ static struct ring_buffer *init_audio(
 
 	unsigned int periods = 2;
 
+	/* HANDMADE_ALSA_DEVICE picks another pcm, e.g. "null" or
+	 * "file:'/tmp/audio.raw',raw" on machines without sound hardware */
+	const char *device_name = getenv("HANDMADE_ALSA_DEVICE");
+	if (!device_name)
+		device_name = "default";
+
 #define ALSA_CHECK(status, msg) \
 	if (status < 0) { \
 		fprintf(stderr, "%s: %s\n", msg, snd_strerror(status)); \
 		return NULL; \
 	}
 
-	/* open connection to default pcm device in playback mode
-	 * TODO: Make this configurable
-	 */
-	status = snd_pcm_open(&pcm_handle, "default", SND_PCM_STREAM_PLAYBACK, 0);
-	ALSA_CHECK(status, "Unable to open default pcm device");
+	/* open connection to the pcm device in playback mode */
+	status = snd_pcm_open(&pcm_handle, device_name, SND_PCM_STREAM_PLAYBACK, 0);
+	ALSA_CHECK(status, "Unable to open pcm device");
 
 	/* allocate struct for hardware parameters */
 	snd_pcm_hw_params_alloca(&hw_params);
@@ -328,8 +698,8 @@ static struct ring_buffer *init_audio(
 	status = snd_pcm_hw_params_any(pcm_handle, hw_params);
 	ALSA_CHECK(status, "Unable to get default hardware configuration for pcm device");
 
-	status = snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-	ALSA_CHECK(status, "Unable to set interleaved access to pcm device");
+	status = snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	ALSA_CHECK(status, "Unable to set mmap interleaved access to pcm device");
 
 	status = snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
 	ALSA_CHECK(status, "Unable to set format for pcm device");
@@ -346,9 +716,23 @@ static struct ring_buffer *init_audio(
 	snd_pcm_uframes_t period_size = latency/periods;
 	status = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params, &period_size, 0);
 	ALSA_CHECK(status, "Unable to set period size for pcm device");
-#undef ALSA_CHECK
 
 	status = snd_pcm_hw_params(pcm_handle, hw_params);
+	ALSA_CHECK(status, "Unable to apply hardware configuration to pcm device");
+
+	/* wake the audio thread once a whole period is free, and start the
+	 * stream explicitly once the first frames are in */
+	snd_pcm_sw_params_alloca(&sw_params);
+
+	status = snd_pcm_sw_params_current(pcm_handle, sw_params);
+	ALSA_CHECK(status, "Unable to get software configuration for pcm device");
+
+	status = snd_pcm_sw_params_set_avail_min(pcm_handle, sw_params, period_size);
+	ALSA_CHECK(status, "Unable to set minimum available frames for pcm device");
+
+	status = snd_pcm_sw_params(pcm_handle, sw_params);
+	ALSA_CHECK(status, "Unable to apply software configuration to pcm device");
+#undef ALSA_CHECK
 
 	/* Check the buffer size is as expected */
 	const unsigned int expected_buffer_time = (1e6 * periods * period_size * 2) / (rate * 2);
@@ -357,33 +741,33 @@ static struct ring_buffer *init_audio(
 
 	assert(actual_buffer_time == expected_buffer_time);
 
-	/* allocate enough memory for the context struct, the play_buffer and the ring buffer */
-	const size_t context_size = sizeof(struct alsa_context);
-	const size_t play_buffer_size = (frame_size * period_size);
-	const size_t ring_buffer_size = (frame_size * buffer_size);
-	const size_t total_memory_size = context_size + play_buffer_size + ring_buffer_size;
+	/* the ring buffer cursors are cache line aligned, its frames are mapped on their own */
+	const size_t arena_marker = memory_arena_mark(arena);
+	context = memory_arena_push_zero(arena, sizeof(struct alsa_context), RING_BUFFER_CACHE_LINE);
 
-	void *memory = malloc(total_memory_size);
-
-	if (!memory) {
+	if (!context) {
 		fprintf(stderr, "Unable to allocate space for ALSA context\n");
 		return NULL;
 	}
 
-	memset(memory, 0, total_memory_size);
-
-	context = memory;
 	context->pcm_handle = pcm_handle;
-	context->rate = rate;
 	context->channels = channels;
 	context->periods = periods;
 	context->period_size = period_size;
-	context->play_buffer = memory + context_size;
 
-	context->buffer.data = memory + context_size + play_buffer_size;
-	context->buffer.size = buffer_size;
-	context->buffer.frame_size = frame_size;
-	context->buffer.target_latency = latency;
+	/* raise on underrun, come back down in steps over half second windows
+	 * while a period stays queued */
+	latency_controller_init(
+		&context->latency, latency, period_size, buffer_size - 1,
+		period_size, rate / 2);
+
+	/* the waits time out after a few periods */
+	if (!audio_stream_init(&context->stream, buffer_size, frame_size,
+			rate, latency, 1 + (4000 * period_size) / rate)) {
+		fprintf(stderr, "Unable to create audio ring: %s\n", strerror(errno));
+		memory_arena_pop(arena, arena_marker);
+		return NULL;
+	}
 
 	/* start audio thread */
 	pthread_t audio_thread;
@@ -391,367 +775,271 @@ static struct ring_buffer *init_audio(
 	status = pthread_create(&audio_thread, NULL, update_audio_thread_driver, context);
 	if (status) {
 		fprintf(stderr, "Unable to create audio thread: %s\n", strerror(status));
-		free(memory);
+		audio_stream_destroy(&context->stream);
+		memory_arena_pop(arena, arena_marker);
 		return NULL;
 	}
 
 	/* ready to roll! */
-	return &context->buffer;
+	return context;
 }
 
-static int init_joysticks()
-{
-	int joystick_count;
-	const int max_joystick_count = 4;
-
-	struct udev *udev;
-	struct udev_enumerate *enumerate;
-	struct udev_list_entry *device_list, *device_list_entry;
-	struct udev_device *device;
-#if 0
-	struct udev_monitor *udev_monitor;
-#endif
+/*
+ * Event sources
+ *
+ * The X connection, the joysticks and the udev monitor all sit in one epoll
+ * set, so a frame with no input costs a single epoll_wait() and only the
+ * sources that are actually readable get read.
+ */
 
-	if (!joysticks) {
-		joysticks = mmap(
-			NULL, max_joystick_count * sizeof(struct joystick),
-			PROT_READ | PROT_WRITE,
-			MAP_ANONYMOUS | MAP_PRIVATE,
-			-1, 0);
-	}
+/* stored in epoll_event.data, the joystick module owns everything after X11 */
+#define EVENT_SOURCE_X11 0
+#define EVENT_SOURCE_JOYSTICKS 1
 
-	for (int i = 0; i < max_joystick_count; ++i) {
-		joysticks[i].system_path = NULL;
-		joysticks[i].device_node = NULL;
-	}
+#define EVENT_BATCH 16
 
-	udev = udev_new();
-	if (!udev) {
-		return 0;
-	}
+static int add_event_source(int epoll_fd, int file_descriptor, uint64_t source)
+{
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u64 = source;
 
-#if 0
-	/* TODO(djr): Actually do something with new controllers */
-	udev_monitor = udev_monitor_new_from_netlink(udev, "udev");
-	if (!udev_monitor) {
-		fputs("Unable to create udev monitor\n", stderr);
-	} else {
-		if (udev_monitor_filter_add_match_subsystem_devtype(udev_monitor, "input", NULL) < 0) {
-			goto error;
-		} else {
-			if (udev_monitor_enable_receiving(udev_monitor) < 0) {
-				error:
-				fputs("Unable to create udev monitor\n", stderr);
-				udev_monitor_unref(udev_monitor);
-				udev_monitor = NULL;
-			}
-		}
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, file_descriptor, &event) < 0) {
+		fprintf(stderr, "Unable to watch file descriptor %d: %s\n", file_descriptor, strerror(errno));
+		return 0;
 	}
-#endif
-
-	enumerate = udev_enumerate_new(udev);
-
-	udev_enumerate_add_match_subsystem(enumerate, "input");
-	udev_enumerate_scan_devices(enumerate);
-	device_list = udev_enumerate_get_list_entry(enumerate);
-
-	joystick_count = 0;
 
-	udev_list_entry_foreach(device_list_entry, device_list) {
-		const char *system_path;
-		const char *device_node;
-		int file_descriptor;
-
-		system_path = udev_list_entry_get_name(device_list_entry);
-		device = udev_device_new_from_syspath(udev, system_path);
-		device_node = udev_device_get_devnode(device);
-
-		if (device_node && strstr(device_node, "/js")) {
-			if ((file_descriptor = open(device_node, O_RDONLY | O_NONBLOCK)) >= 0) {
-				printf("Device system path: %s\n", system_path);
-				printf("Device node path: %s\n", device_node);
-				printf("Device file descriptor: %d\n", file_descriptor);
-				joysticks[joystick_count].system_path = system_path;
-				joysticks[joystick_count].device_node = device_node;
-				joysticks[joystick_count].file_descriptor = file_descriptor;
-			}
-			++joystick_count;
-		}
+	return 1;
+}
 
-	}
 
-	return joystick_count;
-}
+/*
+ * Backend
+ */
 
-struct joystick_state
+struct x11_backend
 {
-	float left_stick_x;
-	float left_stick_y;
-	int a;
-	int b;
+	struct platform_backend backend;
+	struct x11_device device;
+	Atom wm_delete_window;
+	int epoll_fd;
+	struct joysticks *joysticks;
 };
 
-static void update_joystick(const int index, struct joystick_state* state)
+static int x11_start(struct platform_backend *backend, struct memory_arena *arena)
 {
-	int result;
-	struct js_event joystick_event;
-	const int file_descriptor = joysticks[index].file_descriptor;
-
-	result = read(file_descriptor, &joystick_event, sizeof(joystick_event));
-
-	while (result > 0) {
-		switch (joystick_event.type & ~JS_EVENT_INIT) {
-
-			case JS_EVENT_AXIS: {
-				const float value = joystick_event.value / 32767.f;
-				if (joystick_event.number == 0) {
-					state->left_stick_x = value;
-				} else if (joystick_event.number == 1) {
-					state->left_stick_y = value;
-				}
-				break;
-			}
+	struct x11_backend *x11 = (struct x11_backend*)backend;
+	struct x11_device *device = &x11->device;
 
-			case JS_EVENT_BUTTON: {
-				switch (joystick_event.number) {
-					case 0: state->a = joystick_event.value; break;
-					case 1: state->b = joystick_event.value; break;
-					default: {
-						printf("%d %s\n", joystick_event.number,
-								joystick_event.value ? "pressed" : "released");
-					}
-				}
-				break;
-			}
-		}
+	const int width = 1280;
+	const int height = 720;
 
-		result = read(file_descriptor, &joystick_event, sizeof(joystick_event));
-	}
-}
-
-int main()
-{
-	XInitThreads();
-
-	int width = 1280;
-	int height = 720;
-
-	static struct x11_device device;
-	device.display = XOpenDisplay(NULL);
-
-	assert(True == XShmQueryExtension(device.display));
-
-	if (!device.display) {
-		/* TODO(djr): Logging */
-		fputs("X11: Unable to create connection to display server", stderr);
-		return -1;
-	}
-
-	device.screen = DefaultScreen(device.display);
-	device.root = RootWindow(device.display, device.screen);
-
-	if (!XMatchVisualInfo(device.display, device.screen, 32, TrueColor, &device.vinfo)) {
+	if (!XMatchVisualInfo(device->display, device->screen, 32, TrueColor, &device->vinfo)) {
 		/* TODO(djr): Logging */
 		fputs("X11: Unable to find supported visual info", stderr);
-		return -1;
+		return 0;
 	}
 
 	Colormap colormap = XCreateColormap(
-			device.display, device.root, device.vinfo.visual, AllocNone);
+			device->display, device->root, device->vinfo.visual, AllocNone);
 
 	const unsigned long wamask = CWBorderPixel | CWBackPixel | CWColormap | CWEventMask;
 
 	XSetWindowAttributes wa;
 	wa.colormap = colormap;
-	wa.background_pixel = BlackPixel(device.display, device.screen);
+	wa.background_pixel = BlackPixel(device->display, device->screen);
 	wa.border_pixel = 0;
 	wa.event_mask = KeyPressMask | ExposureMask | StructureNotifyMask;
 
-	device.window = XCreateWindow(
-		device.display,
-		device.root,
+	device->window = XCreateWindow(
+		device->display,
+		device->root,
 		0, 0,
 		width, height,
 		0, /* border width */
-		device.vinfo.depth,
+		device->vinfo.depth,
 		InputOutput,
-		device.vinfo.visual,
+		device->vinfo.visual,
 		wamask,
 		&wa);
 
-	if (!device.window) {
+	if (!device->window) {
 		/* TODO(djr): Logging */
 		fputs("X11: Unable to create window", stderr);
-		return -1;
+		return 0;
 	}
 
-	XMapWindow(device.display, device.window);
+	XMapWindow(device->display, device->window);
 
-	device.gc = XCreateGC(device.display, device.window, 0, NULL);
-
-	XStoreName(device.display, device.window, "Simple Engine");
+	XStoreName(device->display, device->window, "Simple Engine");
 
 	/* Give the window a class name so i3 can float it. */
 	XClassHint class_hint = { "Handmade Engine", "GameDev" };
-	XSetClassHint(device.display, device.window, &class_hint);
+	XSetClassHint(device->display, device->window, &class_hint);
+
+	x11->wm_delete_window = XInternAtom(device->display, "WM_DELETE_WINDOW", False);
+	XSetWMProtocols(device->display, device->window, &x11->wm_delete_window, 1);
 
-	Atom wm_delete_window = XInternAtom(device.display, "WM_DELETE_WINDOW", False);
-	XSetWMProtocols(device.display, device.window, &wm_delete_window, 1);
+	resize_window(device, width, height);
 
-	XSizeHints size_hints;
-	size_hints.flags = PMinSize | PMaxSize;
-	size_hints.min_width = size_hints.max_width = width;
-	size_hints.min_height = size_hints.max_height = height;
+	/* the present connection refers to the window, the server has to know it first */
+	XSync(device->display, False);
+	if (!start_present_thread(device, arena))
+		return 0;
+
+	x11->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (x11->epoll_fd < 0) {
+		fprintf(stderr, "Unable to create event loop: %s\n", strerror(errno));
+		return 0;
+	}
 
-	resize_ximage(&device, width, height);
+	add_event_source(x11->epoll_fd, ConnectionNumber(device->display), EVENT_SOURCE_X11);
 
-	const int joystick_count = init_joysticks();
+	x11->joysticks = MEMORY_ARENA_PUSH_STRUCT(arena, struct joysticks);
+	assert(x11->joysticks);
+	joysticks_init(x11->joysticks, x11->epoll_fd, EVENT_SOURCE_JOYSTICKS);
 
-	const int base_hz = 261; /* middle c */
-	const int audio_sample_rate = 48000;
-	const int16_t tone_volume = 6000;
-	struct ring_buffer *audio_buffer = init_audio(
-			audio_sample_rate, audio_sample_rate, audio_sample_rate / 60);
+	return 1;
+}
 
-	struct joystick_state state = {0};
+static struct audio_stream *x11_start_audio(
+	struct platform_backend *backend, struct memory_arena *arena,
+	unsigned int sample_rate, unsigned int buffer_size, unsigned int latency)
+{
+	(void)backend;
 
-	struct timespec t_start;
-	clock_gettime(CLOCK_REALTIME, &t_start);
+	struct alsa_context *audio = init_audio(arena, sample_rate, buffer_size, latency);
+	return audio ? &audio->stream : NULL;
+}
 
-	int xoffset = 0;
-	int yoffset = 0;
+static int x11_poll_input(struct platform_backend *backend, struct input_frame *input)
+{
+	struct x11_backend *x11 = (struct x11_backend*)backend;
+	struct x11_device *device = &x11->device;
+	struct joysticks *joysticks = x11->joysticks;
 	int running = 1;
 
-	while(running) {
-		XEvent e;
-		while(XPending(device.display)) {
-			XNextEvent(device.display, &e);
-			switch(e.type) {
-				case ClientMessage:
-					if (((Atom)e.xclient.data.l[0] == wm_delete_window)) {
-						running = 0;
-					}
-					break;
-				case KeyPress:
-					if (XLookupKeysym(&e.xkey, 0) == XK_Escape) {
-						running = 0;
-					}
-					break;
-				case ConfigureNotify:
-					break;
-				case Expose:
-					break;
-				default:
-					printf("Unhandled XEvent (%d)\n", e.type);
-			}
-		}
+	struct epoll_event events[EVENT_BATCH];
+	const int event_count = epoll_wait(x11->epoll_fd, events, EVENT_BATCH, 0);
 
-		if(joystick_count) {
-			update_joystick(0, &state);
-		}
+	/* round trips elsewhere can leave events queued without the fd being readable */
+	int x11_ready = XEventsQueued(device->display, QueuedAlready) > 0;
+
+	for (int i = 0; i < event_count; ++i) {
+		const uint64_t source = events[i].data.u64;
 
-		if (state.b) {
-			running = 0;
+		if (source == EVENT_SOURCE_X11) {
+			x11_ready = 1;
+		} else if (joysticks_owns_source(joysticks, source)) {
+			joysticks_update(joysticks, source);
 		}
+	}
 
-		// update audio
-		{
-			int16_t *sample_ptr;
-			unsigned int frames_to_write;
-			unsigned int region_one_size;
-			unsigned int region_two_size;
+	XEvent e;
+	while(x11_ready && XPending(device->display)) {
+		XNextEvent(device->display, &e);
 
-			static double t = 0;
-			static unsigned int running_sample_index = 0;
-			static float previous_tone_hz = 0;
+		switch(e.type) {
+			case ClientMessage:
+				if (((Atom)e.xclient.data.l[0] == x11->wm_delete_window)) {
+					running = 0;
+				}
+				break;
+			case KeyPress:
+				if (input->key_count < INPUT_MAX_KEYS) {
+					input->keys[input->key_count++] = XLookupKeysym(&e.xkey, 0);
+				}
+				break;
+			case ConfigureNotify:
+				resize_window(device, e.xconfigure.width, e.xconfigure.height);
+				break;
+			case Expose:
+				device->full_present = 1;
+				break;
+			default:
+				printf("Unhandled XEvent (%d)\n", e.type);
+		}
+	}
 
-			const unsigned int buffer_size = audio_buffer->size;
-			const unsigned int frame_size = audio_buffer->frame_size;
-			const unsigned int read_cursor = audio_buffer->read_cursor;
-			const unsigned int latency = audio_buffer->target_latency;
-			const unsigned int sample_index = running_sample_index % buffer_size;
-			const unsigned int target_cursor = (read_cursor + latency) % buffer_size;
+	/* the whole frame sees one copy of every controller */
+	const struct controller_snapshot controllers = joysticks->state;
 
+	for (int i = 0; i < MAX_CONTROLLERS && i < INPUT_MAX_CONTROLLERS; ++i) {
+		const struct controller_state *player = &controllers.controllers[i];
+		struct input_controller *controller = &input->controllers[i];
 
-			const float tone_hz = base_hz + ((state.left_stick_x - state.left_stick_y) * base_hz / 4);
-			const float tone_diff = tone_hz - previous_tone_hz;
+		if (!player->connected)
+			continue;
 
-			if (sample_index > target_cursor) {
-				frames_to_write = buffer_size - sample_index + target_cursor;
-			} else {
-				frames_to_write = target_cursor - sample_index;
-			}
+		controller->connected = 1;
+		controller->stick_x = controller_axis(player, 0);
+		controller->stick_y = controller_axis(player, 1);
+		controller->buttons =
+			(controller_button(player, 0) ? INPUT_BUTTON_A : 0) |
+			(controller_button(player, 1) ? INPUT_BUTTON_B : 0);
+	}
 
-			if (frames_to_write) {
-				const float tone_step = tone_diff / frames_to_write;
-				float curr_hz = previous_tone_hz;
+	return running;
+}
 
-				if ((sample_index + frames_to_write) >= buffer_size) {
-					region_one_size = buffer_size - sample_index;
-				} else {
-					region_one_size = frames_to_write;
-				}
+static struct offscreen_buffer *x11_acquire_backbuffer(struct platform_backend *backend)
+{
+	return acquire_backbuffer(&((struct x11_backend*)backend)->device);
+}
 
-				region_two_size = frames_to_write - region_one_size;
-
-				sample_ptr = audio_buffer->data + (sample_index * frame_size);
-				for (unsigned int i = 0; i < region_one_size; ++i) {
-					const double wave_period = audio_sample_rate / curr_hz;
-					const int16_t value = sinf(t) * tone_volume * state.a;
-					*sample_ptr++ = value;
-					*sample_ptr++ = value;
-					t += (2.0f * M_PI) / wave_period;
-					curr_hz += tone_step;
-					++running_sample_index;
-				}
+static void x11_present(struct platform_backend *backend)
+{
+	update_window(&((struct x11_backend*)backend)->device);
+}
 
-				sample_ptr = audio_buffer->data;
-				for (unsigned int i = 0; i < region_two_size; ++i) {
-					const double wave_period = audio_sample_rate / curr_hz;
-					const int16_t value = sinf(t) * tone_volume * state.a;
-					*sample_ptr++ = value;
-					*sample_ptr++ = value;
-					t += (2.0f * M_PI) / wave_period;
-					curr_hz += tone_step;
-					++running_sample_index;
-				}
+static void x11_stop(struct platform_backend *backend)
+{
+	struct x11_backend *x11 = (struct x11_backend*)backend;
 
-			}
-			previous_tone_hz = tone_hz;
-
-			audio_buffer->write_cursor = target_cursor;
-		} // update audio
-
-		xoffset -= state.left_stick_x * 5;
-		yoffset -= state.left_stick_y * 5;
-
-		render(&device.backbuffer, xoffset, yoffset);
-		update_window(&device);
-
-		struct timespec t_end;
-		clock_gettime(CLOCK_REALTIME, &t_end);
-		long t_delta = t_end.tv_nsec - t_start.tv_nsec;
-
-		if (t_delta > 0) {
-			const int sample_count = 60;
-			static int report_delay = sample_count;
-			static long t_avg = 0;
-
-			if (!report_delay--) {
-				t_avg /= sample_count;
-				printf("\r%4.2f ms, %4.2f fps", t_avg * 1e-6, 1 / (t_avg * 1e-9));
-				report_delay = sample_count;
-				t_avg = 0;
-			} else {
-				t_avg += t_delta;
-				fflush(stdout);
-			}
-		}
+	joysticks_destroy(x11->joysticks);
+	close(x11->epoll_fd);
+	stop_present_thread(&x11->device);
+	XCloseDisplay(x11->device.display);
+}
 
-		t_start = t_end;
+int main()
+{
+	XInitThreads();
+
+	static struct x11_backend x11 = {
+		.backend = {
+			.name = "x11",
+			.start = x11_start,
+			.start_audio = x11_start_audio,
+			.poll_input = x11_poll_input,
+			.acquire_backbuffer = x11_acquire_backbuffer,
+			.present = x11_present,
+			.stop = x11_stop,
+		},
+	};
+
+	struct x11_device *device = &x11.device;
+	device->display = XOpenDisplay(NULL);
+
+	if (!device->display) {
+		/* TODO(djr): Logging */
+		fputs("X11: Unable to create connection to display server", stderr);
+		return -1;
 	}
 
-	destroy_shm(&device);
-	XCloseDisplay(device.display);
-	return 0;
+	device->screen = DefaultScreen(device->display);
+	device->root = RootWindow(device->display, device->screen);
+	device->max_width = DisplayWidth(device->display, device->screen);
+	device->max_height = DisplayHeight(device->display, device->screen);
+
+	/* the window never gets an image bigger than the screen, and without
+	 * MIT-SHM the present buffers come out of the platform arena */
+	x11.backend.max_width = device->max_width;
+	x11.backend.max_height = device->max_height;
+#ifndef USE_MIT_SHM
+	x11.backend.storage_size = (size_t)PRESENT_BUFFER_COUNT * device->max_width * device->max_height * 4;
+#endif
+
+	const struct engine_options options = { .target_fps = 60 };
+	return engine_run(&x11.backend, &options);
 }
@@ -0,0 +1,93 @@
+#ifndef HANDMADE_MEMORY_ARENA
+#define HANDMADE_MEMORY_ARENA
+
+/*
+ * Linear allocator over a block of memory someone else owns.
+ *
+ * Allocations are pushed onto the end and only ever released all at once,
+ * either back to a marker taken earlier or by resetting the whole arena.
+ * Nothing is ever returned to the system, so an arena carved out of the
+ * platform's up-front reservation never touches the heap.
+ */
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t, uintptr_t */
+#include <string.h> /* memset */
+
+struct memory_arena
+{
+	uint8_t *base;
+	size_t size;
+	size_t used;
+	size_t peak; /* most ever used, for reporting */
+};
+
+#define MEMORY_ARENA_PUSH_STRUCT(arena, type) \
+	((type*)memory_arena_push((arena), sizeof(type), __alignof__(type)))
+#define MEMORY_ARENA_PUSH_ARRAY(arena, type, count) \
+	((type*)memory_arena_push((arena), (count) * sizeof(type), __alignof__(type)))
+
+static inline void memory_arena_init(struct memory_arena *arena, void *base, size_t size)
+{
+	arena->base = base;
+	arena->size = size;
+	arena->used = 0;
+	arena->peak = 0;
+}
+
+/* alignment must be a power of two; returns NULL once the arena is full */
+static inline void *memory_arena_push(struct memory_arena *arena, size_t size, size_t alignment)
+{
+	const uintptr_t address = (uintptr_t)arena->base + arena->used;
+	const size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+	if (padding + size > arena->size - arena->used)
+		return NULL;
+
+	arena->used += padding + size;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+
+	return (void*)(address + padding);
+}
+
+static inline void *memory_arena_push_zero(struct memory_arena *arena, size_t size, size_t alignment)
+{
+	void *memory = memory_arena_push(arena, size, alignment);
+
+	if (memory)
+		memset(memory, 0, size);
+
+	return memory;
+}
+
+/* splits size bytes off the end of parent into their own arena */
+static inline int memory_arena_sub(
+	struct memory_arena *parent, struct memory_arena *child, size_t size, size_t alignment)
+{
+	void *base = memory_arena_push(parent, size, alignment);
+
+	if (!base)
+		return 0;
+
+	memory_arena_init(child, base, size);
+	return 1;
+}
+
+/* everything pushed after a marker is released by popping back to it */
+static inline size_t memory_arena_mark(const struct memory_arena *arena)
+{
+	return arena->used;
+}
+
+static inline void memory_arena_pop(struct memory_arena *arena, size_t marker)
+{
+	arena->used = marker;
+}
+
+static inline void memory_arena_reset(struct memory_arena *arena)
+{
+	arena->used = 0;
+}
+
+#endif /* HANDMADE_MEMORY_ARENA */
@@ -0,0 +1,493 @@
+/* standard library */
+#include <stdio.h> /* fprintf */
+#include <string.h> /* memset, memcpy */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86
+#include <immintrin.h> /* SSE2/AVX2 intrinsics */
+#endif
+
+#include "mixer.h"
+#include "sound_stream.h"
+
+#define MIXER_MAX_VOICES 65535
+#define MIXER_ALIGNMENT 32
+
+static inline unsigned int min_uint(unsigned int x, unsigned int y)
+{
+	return x < y ? x : y;
+}
+
+typedef void mixer_accumulate_fn(
+	float *left, float *right, const float *source,
+	unsigned int count, float left_gain, float right_gain);
+typedef void mixer_accumulate_stereo_fn(
+	float *left, float *right, const float *source_left, const float *source_right,
+	unsigned int count, float left_gain, float right_gain);
+
+/*
+ * Accumulation: left += source * left_gain, right += source * right_gain.
+ * Blocks are padded to a multiple of 8 so the SIMD loops need no tail.
+ */
+static void mixer_accumulate_scalar(
+	float *left, float *right, const float *source,
+	unsigned int count, float left_gain, float right_gain)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		left[i] += source[i] * left_gain;
+		right[i] += source[i] * right_gain;
+	}
+}
+
+/* the same for stereo sources, each side only reaches its own channel */
+static void mixer_accumulate_stereo_scalar(
+	float *left, float *right, const float *source_left, const float *source_right,
+	unsigned int count, float left_gain, float right_gain)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		left[i] += source_left[i] * left_gain;
+		right[i] += source_right[i] * right_gain;
+	}
+}
+
+#ifdef HANDMADE_X86
+static void mixer_accumulate_sse2(
+	float *left, float *right, const float *source,
+	unsigned int count, float left_gain, float right_gain)
+{
+	const __m128 gain_l = _mm_set1_ps(left_gain);
+	const __m128 gain_r = _mm_set1_ps(right_gain);
+
+	for (unsigned int i = 0; i < count; i += 4) {
+		const __m128 s = _mm_load_ps(source + i);
+		_mm_store_ps(left + i, _mm_add_ps(_mm_load_ps(left + i), _mm_mul_ps(s, gain_l)));
+		_mm_store_ps(right + i, _mm_add_ps(_mm_load_ps(right + i), _mm_mul_ps(s, gain_r)));
+	}
+}
+
+__attribute__((target("avx2")))
+static void mixer_accumulate_avx2(
+	float *left, float *right, const float *source,
+	unsigned int count, float left_gain, float right_gain)
+{
+	const __m256 gain_l = _mm256_set1_ps(left_gain);
+	const __m256 gain_r = _mm256_set1_ps(right_gain);
+
+	for (unsigned int i = 0; i < count; i += 8) {
+		const __m256 s = _mm256_load_ps(source + i);
+		_mm256_store_ps(left + i, _mm256_add_ps(_mm256_load_ps(left + i), _mm256_mul_ps(s, gain_l)));
+		_mm256_store_ps(right + i, _mm256_add_ps(_mm256_load_ps(right + i), _mm256_mul_ps(s, gain_r)));
+	}
+}
+
+static void mixer_accumulate_stereo_sse2(
+	float *left, float *right, const float *source_left, const float *source_right,
+	unsigned int count, float left_gain, float right_gain)
+{
+	const __m128 gain_l = _mm_set1_ps(left_gain);
+	const __m128 gain_r = _mm_set1_ps(right_gain);
+
+	for (unsigned int i = 0; i < count; i += 4) {
+		_mm_store_ps(left + i, _mm_add_ps(_mm_load_ps(left + i), _mm_mul_ps(_mm_load_ps(source_left + i), gain_l)));
+		_mm_store_ps(right + i, _mm_add_ps(_mm_load_ps(right + i), _mm_mul_ps(_mm_load_ps(source_right + i), gain_r)));
+	}
+}
+
+__attribute__((target("avx2")))
+static void mixer_accumulate_stereo_avx2(
+	float *left, float *right, const float *source_left, const float *source_right,
+	unsigned int count, float left_gain, float right_gain)
+{
+	const __m256 gain_l = _mm256_set1_ps(left_gain);
+	const __m256 gain_r = _mm256_set1_ps(right_gain);
+
+	for (unsigned int i = 0; i < count; i += 8) {
+		_mm256_store_ps(left + i, _mm256_add_ps(_mm256_load_ps(left + i), _mm256_mul_ps(_mm256_load_ps(source_left + i), gain_l)));
+		_mm256_store_ps(right + i, _mm256_add_ps(_mm256_load_ps(right + i), _mm256_mul_ps(_mm256_load_ps(source_right + i), gain_r)));
+	}
+}
+#endif /* HANDMADE_X86 */
+
+static mixer_accumulate_fn *mixer_accumulate;
+static mixer_accumulate_stereo_fn *mixer_accumulate_stereo;
+
+static void select_mixer_accumulate(void)
+{
+	mixer_accumulate = mixer_accumulate_scalar;
+	mixer_accumulate_stereo = mixer_accumulate_stereo_scalar;
+
+#ifdef HANDMADE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) {
+		mixer_accumulate = mixer_accumulate_sse2;
+		mixer_accumulate_stereo = mixer_accumulate_stereo_sse2;
+	}
+
+	if (__builtin_cpu_supports("avx2")) {
+		mixer_accumulate = mixer_accumulate_avx2;
+		mixer_accumulate_stereo = mixer_accumulate_stereo_avx2;
+	}
+#endif
+}
+
+/*
+ * Converts planar float in [-1, 1] to interleaved S16, clamping anything
+ * louder than full scale.
+ */
+static void mixer_convert(
+	int16_t *frames, const float *left, const float *right, unsigned int count)
+{
+	unsigned int i = 0;
+
+#ifdef HANDMADE_X86
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 max = _mm_set1_ps(32767.0f);
+	const __m128 min = _mm_set1_ps(-32768.0f);
+
+	for (; i + 8 <= count; i += 8) {
+		/* clamp before converting, cvtps gives 0x80000000 for out of range */
+		const __m128i l0 = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_load_ps(left + i), scale), max), min));
+		const __m128i l1 = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_load_ps(left + i + 4), scale), max), min));
+		const __m128i r0 = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_load_ps(right + i), scale), max), min));
+		const __m128i r1 = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_load_ps(right + i + 4), scale), max), min));
+
+		const __m128i l = _mm_packs_epi32(l0, l1);
+		const __m128i r = _mm_packs_epi32(r0, r1);
+
+		_mm_storeu_si128((__m128i*)(frames + 2 * i), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i*)(frames + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		float l = left[i] * 32767.0f;
+		float r = right[i] * 32767.0f;
+		l = l > 32767.0f ? 32767.0f : l < -32768.0f ? -32768.0f : l;
+		r = r > 32767.0f ? 32767.0f : r < -32768.0f ? -32768.0f : r;
+		frames[2 * i] = (int16_t)__builtin_lrintf(l);
+		frames[2 * i + 1] = (int16_t)__builtin_lrintf(r);
+	}
+}
+
+int mixer_init(
+	struct mixer *mixer, struct memory_arena *arena, unsigned int sample_rate,
+	unsigned int voice_count, unsigned int block_size)
+{
+	memset(mixer, 0, sizeof(*mixer));
+
+	if (!voice_count || voice_count > MIXER_MAX_VOICES || !block_size) {
+		fprintf(stderr, "Invalid mixer configuration: %u voices, %u frame blocks\n",
+			voice_count, block_size);
+		return 0;
+	}
+
+	if (!mixer_accumulate)
+		select_mixer_accumulate();
+
+	/* round blocks up to whole AVX registers */
+	block_size = (block_size + 7) & ~7u;
+
+	const size_t voices_size = voice_count * sizeof(struct mixer_voice);
+	const size_t indices_size = 2 * voice_count * sizeof(uint16_t);
+	const size_t block_bytes = block_size * sizeof(float);
+	const size_t header_size = (voices_size + indices_size + MIXER_ALIGNMENT - 1) & ~(size_t)(MIXER_ALIGNMENT - 1);
+
+	void *memory = memory_arena_push_zero(arena, header_size + 4 * block_bytes, MIXER_ALIGNMENT);
+	if (!memory) {
+		fprintf(stderr, "Unable to allocate mixer\n");
+		return 0;
+	}
+
+	mixer->sample_rate = sample_rate;
+	mixer->block_size = block_size;
+	mixer->voice_count = voice_count;
+	mixer->voices = memory;
+	mixer->active_voices = (uint16_t*)((char*)memory + voices_size);
+	mixer->free_voices = mixer->active_voices + voice_count;
+	mixer->source = (float*)((char*)memory + header_size);
+	mixer->source_right = mixer->source + block_size;
+	mixer->left = mixer->source_right + block_size;
+	mixer->right = mixer->left + block_size;
+
+	/* hand out low indices first */
+	for (unsigned int i = 0; i < voice_count; ++i)
+		mixer->free_voices[i] = voice_count - 1 - i;
+	mixer->free_count = voice_count;
+
+	return 1;
+}
+
+static struct mixer_voice *get_voice(struct mixer *mixer, mixer_voice_handle handle)
+{
+	if (handle < 0)
+		return NULL;
+
+	const unsigned int index = handle & 0xffff;
+	const unsigned int generation = (handle >> 16) & 0xffff;
+
+	if (index >= mixer->voice_count)
+		return NULL;
+
+	struct mixer_voice *voice = &mixer->voices[index];
+	return voice->active && voice->generation == generation ? voice : NULL;
+}
+
+static mixer_voice_handle start_voice(
+	struct mixer *mixer, enum mixer_source_type type, float volume, float pan,
+	struct mixer_voice **result)
+{
+	if (!mixer->free_count)
+		return MIXER_INVALID_VOICE;
+
+	const unsigned int index = mixer->free_voices[--mixer->free_count];
+	struct mixer_voice *voice = &mixer->voices[index];
+
+	/* keep the top bit clear so handles stay positive */
+	const uint16_t generation = (voice->generation + 1) & 0x7fff;
+
+	memset(voice, 0, sizeof(*voice));
+	voice->type = type;
+	voice->volume = volume;
+	voice->pan = pan;
+	voice->generation = generation;
+	voice->active = 1;
+	voice->active_slot = mixer->active_count;
+	mixer->active_voices[mixer->active_count++] = index;
+
+	*result = voice;
+	return (mixer_voice_handle)(((uint32_t)generation << 16) | index);
+}
+
+static void release_voice(struct mixer *mixer, struct mixer_voice *voice)
+{
+	const unsigned int index = voice - mixer->voices;
+	const unsigned int slot = voice->active_slot;
+	const unsigned int last = mixer->active_voices[--mixer->active_count];
+
+	/* move the last active voice into the hole */
+	mixer->active_voices[slot] = last;
+	mixer->voices[last].active_slot = slot;
+
+	voice->active = 0;
+	mixer->free_voices[mixer->free_count++] = index;
+}
+
+mixer_voice_handle mixer_play_tone(
+	struct mixer *mixer, float hz, float volume, float pan)
+{
+	struct mixer_voice *voice;
+	const mixer_voice_handle handle = start_voice(
+		mixer, MIXER_SOURCE_OSCILLATOR, volume, pan, &voice);
+
+	if (handle != MIXER_INVALID_VOICE)
+		oscillator_init(&voice->tone.oscillator, mixer->sample_rate, hz);
+
+	return handle;
+}
+
+mixer_voice_handle mixer_play_samples(
+	struct mixer *mixer, const float *samples, unsigned int length,
+	int loop, float volume, float pan)
+{
+	struct mixer_voice *voice;
+
+	if (!samples || !length)
+		return MIXER_INVALID_VOICE;
+
+	const mixer_voice_handle handle = start_voice(
+		mixer, MIXER_SOURCE_SAMPLES, volume, pan, &voice);
+
+	if (handle != MIXER_INVALID_VOICE) {
+		voice->buffer.samples = samples;
+		voice->buffer.length = length;
+		voice->buffer.loop = loop;
+	}
+
+	return handle;
+}
+
+mixer_voice_handle mixer_play_stream(
+	struct mixer *mixer, struct sound_stream *stream, float volume, float pan)
+{
+	struct mixer_voice *voice;
+
+	if (!stream)
+		return MIXER_INVALID_VOICE;
+
+	const mixer_voice_handle handle = start_voice(
+		mixer, MIXER_SOURCE_STREAM, volume, pan, &voice);
+
+	if (handle != MIXER_INVALID_VOICE)
+		voice->stream = stream;
+
+	return handle;
+}
+
+void mixer_stop(struct mixer *mixer, mixer_voice_handle handle)
+{
+	struct mixer_voice *voice = get_voice(mixer, handle);
+	if (voice)
+		release_voice(mixer, voice);
+}
+
+void mixer_set_volume(struct mixer *mixer, mixer_voice_handle handle, float volume)
+{
+	struct mixer_voice *voice = get_voice(mixer, handle);
+	if (voice)
+		voice->volume = volume;
+}
+
+void mixer_set_pan(struct mixer *mixer, mixer_voice_handle handle, float pan)
+{
+	struct mixer_voice *voice = get_voice(mixer, handle);
+	if (voice)
+		voice->pan = pan;
+}
+
+void mixer_set_frequency(
+	struct mixer *mixer, mixer_voice_handle handle, float hz, unsigned int glide_frames)
+{
+	struct mixer_voice *voice = get_voice(mixer, handle);
+	if (!voice || voice->type != MIXER_SOURCE_OSCILLATOR)
+		return;
+
+	if (glide_frames) {
+		voice->tone.hz_step = (hz - voice->tone.oscillator.hz) / glide_frames;
+		voice->tone.glide_frames = glide_frames;
+	} else {
+		voice->tone.oscillator.hz = hz;
+		voice->tone.hz_step = 0;
+		voice->tone.glide_frames = 0;
+	}
+}
+
+static void convert_stream_frames(
+	float *left, float *right, const int16_t *samples, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		left[i] = samples[2 * i] * (1.0f / 32768.0f);
+		right[i] = samples[2 * i + 1] * (1.0f / 32768.0f);
+	}
+}
+
+/*
+ * Copies what the reader has ready out of a stream's ring, converted to
+ * planar float. Anything it hasn't read yet plays as silence; the frame
+ * never waits for it.
+ */
+static int render_stream(
+	struct sound_stream *stream, float *left, float *right, unsigned int count)
+{
+	/* loaded before the ring, so FINISHED means everything is in it */
+	const int state = __atomic_load_n(&stream->state, __ATOMIC_ACQUIRE);
+	struct ring_buffer *ring = &stream->buffer;
+	const unsigned int available = ring_buffer_read_available(ring);
+	const unsigned int frames = min_uint(available, count);
+
+	/* the ring is mirrored, so the frames are contiguous across the wrap */
+	convert_stream_frames(left, right, ring_buffer_frame(ring, ring->read_cursor), frames);
+
+	memset(left + frames, 0, (count - frames) * sizeof(float));
+	memset(right + frames, 0, (count - frames) * sizeof(float));
+	ring_buffer_commit_read(ring, frames);
+
+	if (frames < count && state == SOUND_STREAM_PLAYING)
+		__atomic_store_n(&stream->starved, stream->starved + 1, __ATOMIC_RELAXED);
+
+	return !(state == SOUND_STREAM_FINISHED && frames == available);
+}
+
+/* returns 0 once the voice has nothing left to play; only stereo sources fill source_right */
+static int render_voice(
+	struct mixer_voice *voice, float *source, float *source_right, unsigned int count)
+{
+	switch (voice->type) {
+		case MIXER_SOURCE_OSCILLATOR: {
+			const unsigned int glide = min_uint(count, voice->tone.glide_frames);
+
+			oscillator_fill(&voice->tone.oscillator, source, glide, voice->tone.hz_step);
+			voice->tone.glide_frames -= glide;
+
+			if (!voice->tone.glide_frames)
+				voice->tone.hz_step = 0;
+
+			if (glide < count)
+				oscillator_fill(&voice->tone.oscillator, source + glide, count - glide, 0.0f);
+
+			return 1;
+		}
+
+		case MIXER_SOURCE_SAMPLES: {
+			unsigned int written = 0;
+
+			while (written < count) {
+				const unsigned int left = voice->buffer.length - voice->buffer.position;
+				const unsigned int frames = min_uint(left, count - written);
+
+				memcpy(source + written,
+					voice->buffer.samples + voice->buffer.position,
+					frames * sizeof(float));
+
+				written += frames;
+				voice->buffer.position += frames;
+
+				if (voice->buffer.position == voice->buffer.length) {
+					if (!voice->buffer.loop)
+						break;
+					voice->buffer.position = 0;
+				}
+			}
+
+			/* a finished sound plays silence for the rest of the block */
+			memset(source + written, 0, (count - written) * sizeof(float));
+			return voice->buffer.position < voice->buffer.length;
+		}
+
+		case MIXER_SOURCE_STREAM:
+			return render_stream(voice->stream, source, source_right, count);
+	}
+
+	return 0;
+}
+
+void mixer_mix(struct mixer *mixer, int16_t *frames, unsigned int count)
+{
+	while (count) {
+		const unsigned int block = min_uint(count, mixer->block_size);
+		/* the SIMD loops run over whole registers, the padding is ignored */
+		const unsigned int padded = (block + 7) & ~7u;
+
+		memset(mixer->left, 0, padded * sizeof(float));
+		memset(mixer->right, 0, padded * sizeof(float));
+
+		for (unsigned int i = 0; i < mixer->active_count;) {
+			struct mixer_voice *voice = &mixer->voices[mixer->active_voices[i]];
+
+			/* balance rather than constant power: centre plays at full
+			 * volume in both channels */
+			const float left_gain = voice->volume * (voice->pan > 0.0f ? 1.0f - voice->pan : 1.0f);
+			const float right_gain = voice->volume * (voice->pan < 0.0f ? 1.0f + voice->pan : 1.0f);
+			const int playing = render_voice(voice, mixer->source, mixer->source_right, block);
+
+			if (voice->type == MIXER_SOURCE_STREAM) {
+				mixer_accumulate_stereo(mixer->left, mixer->right,
+					mixer->source, mixer->source_right, padded, left_gain, right_gain);
+			} else {
+				mixer_accumulate(mixer->left, mixer->right, mixer->source, padded, left_gain, right_gain);
+			}
+
+			if (playing) {
+				++i;
+			} else {
+				/* the last active voice moves into slot i */
+				release_voice(mixer, voice);
+			}
+		}
+
+		mixer_convert(frames, mixer->left, mixer->right, block);
+
+		frames += 2 * block;
+		count -= block;
+	}
+}
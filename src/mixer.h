@@ -0,0 +1,103 @@
+#ifndef HANDMADE_MIXER
+#define HANDMADE_MIXER
+
+#include <stdint.h> /* int16_t */
+
+#include "memory_arena.h"
+#include "oscillator.h"
+
+/*
+ * Software mixer over a fixed pool of voices. Everything is taken from the
+ * arena in mixer_init(); mixing walks only the active voices, accumulates
+ * them into planar float left/right blocks and converts the result to
+ * interleaved stereo S16 with saturation.
+ *
+ * Voices are referred to by handles that carry a generation count, so a
+ * handle to a voice that has finished is simply ignored rather than
+ * touching whichever sound reused the slot.
+ */
+
+struct sound_stream;
+
+typedef int32_t mixer_voice_handle;
+#define MIXER_INVALID_VOICE ((mixer_voice_handle)-1)
+
+enum mixer_source_type
+{
+	MIXER_SOURCE_OSCILLATOR,
+	MIXER_SOURCE_SAMPLES,
+	MIXER_SOURCE_STREAM,
+};
+
+struct mixer_voice
+{
+	enum mixer_source_type type;
+	float volume; /* linear, 1.0 is full scale */
+	float pan; /* -1.0 left to 1.0 right */
+	uint16_t generation;
+	uint16_t active_slot;
+	int active;
+
+	union {
+		struct {
+			struct oscillator oscillator;
+			float hz_step;
+			unsigned int glide_frames; /* left to go before hz_step stops */
+		} tone;
+
+		struct {
+			const float *samples; /* mono */
+			unsigned int length;
+			unsigned int position;
+			int loop;
+		} buffer;
+
+		struct sound_stream *stream; /* stereo */
+	};
+};
+
+struct mixer
+{
+	unsigned int sample_rate;
+	unsigned int block_size; /* frames mixed per pass */
+	unsigned int voice_count;
+	unsigned int active_count;
+	unsigned int free_count;
+
+	struct mixer_voice *voices;
+	uint16_t *active_voices; /* indices of playing voices, packed */
+	uint16_t *free_voices; /* stack of unused voice indices */
+
+	float *source; /* one block of the voice being mixed */
+	float *source_right; /* and its right channel, for stereo sources */
+	float *left;
+	float *right;
+};
+
+/* takes the voices and blocks out of arena, returns 0 if they don't fit */
+int mixer_init(
+	struct mixer *mixer, struct memory_arena *arena, unsigned int sample_rate,
+	unsigned int voice_count, unsigned int block_size);
+
+mixer_voice_handle mixer_play_tone(
+	struct mixer *mixer, float hz, float volume, float pan);
+mixer_voice_handle mixer_play_samples(
+	struct mixer *mixer, const float *samples, unsigned int length,
+	int loop, float volume, float pan);
+
+/* plays a track from the sound streamer until it finishes */
+mixer_voice_handle mixer_play_stream(
+	struct mixer *mixer, struct sound_stream *stream, float volume, float pan);
+
+void mixer_stop(struct mixer *mixer, mixer_voice_handle voice);
+void mixer_set_volume(struct mixer *mixer, mixer_voice_handle voice, float volume);
+void mixer_set_pan(struct mixer *mixer, mixer_voice_handle voice, float pan);
+
+/* glides a tone voice to hz over the next glide_frames mixed frames */
+void mixer_set_frequency(
+	struct mixer *mixer, mixer_voice_handle voice, float hz, unsigned int glide_frames);
+
+/* mixes every active voice into count interleaved stereo S16 frames */
+void mixer_mix(struct mixer *mixer, int16_t *frames, unsigned int count);
+
+#endif /* HANDMADE_MIXER */
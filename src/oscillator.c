@@ -0,0 +1,199 @@
+#include <math.h> /* floorf */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86
+#include <immintrin.h> /* SSE2/AVX2 intrinsics */
+#endif
+
+#include "oscillator.h"
+
+typedef void oscillator_fill_fn(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step);
+
+/*
+ * sin(2 * pi * phase) for phase in [0, 1). Folded to y in [-0.5, 0.5) the
+ * parabola 8y - 16y|y| matches sine at the zeros and peaks, and one
+ * refinement step brings the error down to about 0.001, well under what
+ * 16 bit output can resolve at game volumes.
+ */
+static inline float sine_turns(float phase)
+{
+	const float y = phase - 0.5f;
+	float s = 8.0f * y - 16.0f * y * fabsf(y);
+	s = 0.225f * (s * fabsf(s) - s) + s;
+	return -s;
+}
+
+static inline float wrap_phase(float phase)
+{
+	return phase - floorf(phase);
+}
+
+static void oscillator_fill_scalar(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step)
+{
+	const float inverse_rate = 1.0f / oscillator->sample_rate;
+	float phase = oscillator->phase;
+	float hz = oscillator->hz;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		samples[i] = sine_turns(phase);
+		phase = wrap_phase(phase + hz * inverse_rate);
+		hz += hz_step;
+	}
+
+	oscillator->phase = phase;
+	oscillator->hz = hz;
+}
+
+#ifdef HANDMADE_X86
+/*
+ * The SIMD paths work on groups of 8 samples. With the frequency of the
+ * group's first sample hz and the per-sample step d, lane j's phase is
+ *
+ *   phase + (j * hz + d * j * (j - 1) / 2) / rate
+ *
+ * so each group only needs one scalar phase and frequency update. Lane
+ * phases are non-negative, so truncation is floor.
+ */
+static const float lane_index[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+static const float lane_glide[8] = { 0, 0, 1, 3, 6, 10, 15, 21 };
+
+static inline __m128 sine_turns_sse2(__m128 phase)
+{
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+	phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+
+	const __m128 y = _mm_sub_ps(phase, _mm_set1_ps(0.5f));
+	const __m128 abs_y = _mm_andnot_ps(sign_mask, y);
+	__m128 s = _mm_sub_ps(
+		_mm_mul_ps(_mm_set1_ps(8.0f), y),
+		_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(16.0f), y), abs_y));
+
+	const __m128 abs_s = _mm_andnot_ps(sign_mask, s);
+	s = _mm_add_ps(
+		_mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(s, abs_s), s)), s);
+
+	return _mm_xor_ps(s, sign_mask);
+}
+
+static void oscillator_fill_sse2(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step)
+{
+	const float inverse_rate = 1.0f / oscillator->sample_rate;
+	const __m128 index_lo = _mm_loadu_ps(lane_index);
+	const __m128 index_hi = _mm_loadu_ps(lane_index + 4);
+	const __m128 glide_lo = _mm_mul_ps(_mm_loadu_ps(lane_glide), _mm_set1_ps(hz_step));
+	const __m128 glide_hi = _mm_mul_ps(_mm_loadu_ps(lane_glide + 4), _mm_set1_ps(hz_step));
+	const __m128 rate = _mm_set1_ps(inverse_rate);
+	const float group_glide = 28.0f * hz_step;
+
+	float phase = oscillator->phase;
+	float hz = oscillator->hz;
+
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m128 base = _mm_set1_ps(phase);
+		const __m128 group_hz = _mm_set1_ps(hz);
+
+		const __m128 lo = _mm_add_ps(base,
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(index_lo, group_hz), glide_lo), rate));
+		const __m128 hi = _mm_add_ps(base,
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(index_hi, group_hz), glide_hi), rate));
+
+		_mm_storeu_ps(samples + i, sine_turns_sse2(lo));
+		_mm_storeu_ps(samples + i + 4, sine_turns_sse2(hi));
+
+		phase = wrap_phase(phase + (8.0f * hz + group_glide) * inverse_rate);
+		hz += 8.0f * hz_step;
+	}
+
+	oscillator->phase = phase;
+	oscillator->hz = hz;
+
+	oscillator_fill_scalar(oscillator, samples + i, count - i, hz_step);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 sine_turns_avx2(__m256 phase)
+{
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+	phase = _mm256_sub_ps(phase, _mm256_floor_ps(phase));
+
+	const __m256 y = _mm256_sub_ps(phase, _mm256_set1_ps(0.5f));
+	const __m256 abs_y = _mm256_andnot_ps(sign_mask, y);
+	__m256 s = _mm256_sub_ps(
+		_mm256_mul_ps(_mm256_set1_ps(8.0f), y),
+		_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(16.0f), y), abs_y));
+
+	const __m256 abs_s = _mm256_andnot_ps(sign_mask, s);
+	s = _mm256_add_ps(
+		_mm256_mul_ps(_mm256_set1_ps(0.225f), _mm256_sub_ps(_mm256_mul_ps(s, abs_s), s)), s);
+
+	return _mm256_xor_ps(s, sign_mask);
+}
+
+__attribute__((target("avx2")))
+static void oscillator_fill_avx2(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step)
+{
+	const float inverse_rate = 1.0f / oscillator->sample_rate;
+	const __m256 index = _mm256_loadu_ps(lane_index);
+	const __m256 glide = _mm256_mul_ps(_mm256_loadu_ps(lane_glide), _mm256_set1_ps(hz_step));
+	const __m256 rate = _mm256_set1_ps(inverse_rate);
+	const float group_glide = 28.0f * hz_step;
+
+	float phase = oscillator->phase;
+	float hz = oscillator->hz;
+
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 lanes = _mm256_add_ps(_mm256_set1_ps(phase),
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(index, _mm256_set1_ps(hz)), glide), rate));
+
+		_mm256_storeu_ps(samples + i, sine_turns_avx2(lanes));
+
+		phase = wrap_phase(phase + (8.0f * hz + group_glide) * inverse_rate);
+		hz += 8.0f * hz_step;
+	}
+
+	oscillator->phase = phase;
+	oscillator->hz = hz;
+
+	oscillator_fill_scalar(oscillator, samples + i, count - i, hz_step);
+}
+#endif /* HANDMADE_X86 */
+
+static oscillator_fill_fn *select_oscillator_fill(void)
+{
+#ifdef HANDMADE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return oscillator_fill_avx2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return oscillator_fill_sse2;
+#endif
+	return oscillator_fill_scalar;
+}
+
+static oscillator_fill_fn *oscillator_fill_impl;
+
+void oscillator_init(struct oscillator *oscillator, float sample_rate, float hz)
+{
+	if (!oscillator_fill_impl)
+		oscillator_fill_impl = select_oscillator_fill();
+
+	oscillator->phase = 0.0f;
+	oscillator->hz = hz;
+	oscillator->sample_rate = sample_rate;
+}
+
+void oscillator_fill(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step)
+{
+	oscillator_fill_impl(oscillator, samples, count, hz_step);
+}
@@ -0,0 +1,26 @@
+#ifndef HANDMADE_OSCILLATOR
+#define HANDMADE_OSCILLATOR
+
+/*
+ * Sine oscillator driven by a phase accumulator. The phase is kept in turns
+ * ([0, 1) rather than radians) so wrapping it is a subtraction, and the sine
+ * is a polynomial approximation evaluated several samples at a time.
+ */
+struct oscillator
+{
+	float phase; /* turns, [0, 1) */
+	float hz;
+	float sample_rate;
+};
+
+void oscillator_init(struct oscillator *oscillator, float sample_rate, float hz);
+
+/*
+ * Writes count samples in [-1, 1] starting at oscillator->hz and adding
+ * hz_step to the frequency after every sample, which gives a linear glide
+ * across the block. The phase and frequency carry over to the next call.
+ */
+void oscillator_fill(
+	struct oscillator *oscillator, float *samples, unsigned int count, float hz_step);
+
+#endif /* HANDMADE_OSCILLATOR */
@@ -1,9 +1,19 @@
 #include <stdint.h> /* (u)intXX_t */
 #include <stddef.h> /* size_t */
+#include <math.h> /* floorf */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86
+#include <immintrin.h> /* SSE2/AVX2 intrinsics */
+#endif
 
 #include "platform.h"
+#include "trace.h"
+
+typedef void render_gradient_fn(
+	struct offscreen_buffer *buffer, int xoffset, int yoffset);
 
-static void render_gradient(
+static void render_gradient_scalar(
 	struct offscreen_buffer *buffer, int xoffset, int yoffset)
 {
 	const int width = buffer->width;
@@ -25,7 +35,234 @@ static void render_gradient(
 	}
 }
 
-void render(struct offscreen_buffer *buffer, int xoffset, int yoffset)
+#ifdef HANDMADE_X86
+/*
+ * The SIMD kernels build the same pixels as the scalar loop: alpha and green
+ * are constant across a row, so only the low byte of (x + xoffset) varies
+ * per lane. Whatever doesn't fill a whole vector at the end of a row is
+ * finished with the scalar expression so odd widths and padded pitches
+ * never write outside the row.
+ */
+static void render_gradient_sse2(
+	struct offscreen_buffer *buffer, int xoffset, int yoffset)
+{
+	const int width = buffer->width;
+	const int height = buffer->height;
+	const int pitch = buffer->pitch;
+
+	const __m128i blue_mask = _mm_set1_epi32(0xff);
+	const __m128i step = _mm_set1_epi32(4);
+
+	uint8_t *row = (uint8_t*)buffer->pixels;
+	for (int y = 0; y < height; ++y) {
+		const uint32_t row_bits = (0xffu << 24) | ((uint8_t)(y + yoffset) << 8);
+		const __m128i base = _mm_set1_epi32(row_bits);
+
+		uint32_t *pixel = (uint32_t*)row;
+		__m128i blue = _mm_setr_epi32(xoffset, xoffset + 1, xoffset + 2, xoffset + 3);
+
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			const __m128i value = _mm_or_si128(base, _mm_and_si128(blue, blue_mask));
+			_mm_storeu_si128((__m128i*)pixel, value);
+			blue = _mm_add_epi32(blue, step);
+			pixel += 4;
+		}
+
+		for (; x < width; ++x) {
+			*pixel++ = row_bits | (uint8_t)(x + xoffset);
+		}
+
+		row += pitch;
+	}
+}
+
+__attribute__((target("avx2")))
+static void render_gradient_avx2(
+	struct offscreen_buffer *buffer, int xoffset, int yoffset)
+{
+	const int width = buffer->width;
+	const int height = buffer->height;
+	const int pitch = buffer->pitch;
+
+	const __m256i blue_mask = _mm256_set1_epi32(0xff);
+	const __m256i step = _mm256_set1_epi32(16);
+
+	uint8_t *row = (uint8_t*)buffer->pixels;
+	for (int y = 0; y < height; ++y) {
+		const uint32_t row_bits = (0xffu << 24) | ((uint8_t)(y + yoffset) << 8);
+		const __m256i base = _mm256_set1_epi32(row_bits);
+
+		uint32_t *pixel = (uint32_t*)row;
+		__m256i blue_lo = _mm256_setr_epi32(
+			xoffset,     xoffset + 1, xoffset + 2,  xoffset + 3,
+			xoffset + 4, xoffset + 5, xoffset + 6,  xoffset + 7);
+		__m256i blue_hi = _mm256_add_epi32(blue_lo, _mm256_set1_epi32(8));
+
+		/* two registers per iteration, 16 pixels */
+		int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			const __m256i lo = _mm256_or_si256(base, _mm256_and_si256(blue_lo, blue_mask));
+			const __m256i hi = _mm256_or_si256(base, _mm256_and_si256(blue_hi, blue_mask));
+			_mm256_storeu_si256((__m256i*)pixel, lo);
+			_mm256_storeu_si256((__m256i*)(pixel + 8), hi);
+			blue_lo = _mm256_add_epi32(blue_lo, step);
+			blue_hi = _mm256_add_epi32(blue_hi, step);
+			pixel += 16;
+		}
+
+		if (x + 8 <= width) {
+			const __m256i lo = _mm256_or_si256(base, _mm256_and_si256(blue_lo, blue_mask));
+			_mm256_storeu_si256((__m256i*)pixel, lo);
+			pixel += 8;
+			x += 8;
+		}
+
+		for (; x < width; ++x) {
+			*pixel++ = row_bits | (uint8_t)(x + xoffset);
+		}
+
+		row += pitch;
+	}
+}
+#endif /* HANDMADE_X86 */
+
+/* picks the widest kernel the cpu supports */
+static render_gradient_fn *select_render_gradient(void)
+{
+#ifdef HANDMADE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		return render_gradient_avx2;
+
+	if (__builtin_cpu_supports("sse2"))
+		return render_gradient_sse2;
+#endif
+	return render_gradient_scalar;
+}
+
+static render_gradient_fn *render_gradient;
+
+/*
+ * The backbuffer is split into tiles small enough to stay in L1 while they
+ * are written (128 * 32 * 4 bytes = 16KB) and the tiles are shared out
+ * between the render threads.
+ */
+#define TILE_WIDTH 128
+#define TILE_HEIGHT 32
+
+struct render_job
+{
+	struct offscreen_buffer *buffer;
+	unsigned int tiles_x;
+	int xoffset;
+	int yoffset;
+};
+
+static void render_tile(void *context, unsigned int index)
+{
+	const struct render_job *job = context;
+	const struct offscreen_buffer *buffer = job->buffer;
+
+	const size_t tile_x = (index % job->tiles_x) * TILE_WIDTH;
+	const size_t tile_y = (index / job->tiles_x) * TILE_HEIGHT;
+
+	struct offscreen_buffer tile;
+	tile.pixels = (uint8_t*)buffer->pixels + tile_y * buffer->pitch + tile_x * 4;
+	tile.width = buffer->width - tile_x < TILE_WIDTH ? buffer->width - tile_x : TILE_WIDTH;
+	tile.height = buffer->height - tile_y < TILE_HEIGHT ? buffer->height - tile_y : TILE_HEIGHT;
+	tile.pitch = buffer->pitch;
+
+	render_gradient(&tile, job->xoffset + tile_x, job->yoffset + tile_y);
+}
+
+static void render(
+	struct game_memory *memory, struct offscreen_buffer *buffer, int xoffset, int yoffset)
 {
-	render_gradient(buffer, xoffset, yoffset);
+	TRACE_SCOPE("render");
+
+	/* statics start out empty again after every reload */
+	if (!render_gradient)
+		render_gradient = select_render_gradient();
+
+	struct render_job job;
+	job.buffer = buffer;
+	job.tiles_x = (buffer->width + TILE_WIDTH - 1) / TILE_WIDTH;
+	job.xoffset = xoffset;
+	job.yoffset = yoffset;
+
+	const unsigned int tiles_y = (buffer->height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+	memory->platform.run_work(
+		memory->platform.render_queue, render_tile, &job, job.tiles_x * tiles_y);
+}
+
+struct game_state
+{
+	float x;
+	float y;
+	float previous_x;
+	float previous_y;
+
+	/* what the screen shows, so a frame that wouldn't change it is skipped */
+	int drawn;
+	int drawn_xoffset;
+	int drawn_yoffset;
+	size_t drawn_width;
+	size_t drawn_height;
+};
+
+/* the state is the first thing pushed, so a reloaded game finds it again */
+static struct game_state *get_game_state(struct game_memory *memory)
+{
+	if (!memory->permanent.used)
+		return memory_arena_push_zero(
+			&memory->permanent, sizeof(struct game_state), __alignof__(struct game_state));
+
+	return (struct game_state*)memory->permanent.base;
+}
+
+GAME_UPDATE(game_update)
+{
+	struct game_state *state = get_game_state(memory);
+
+	const float scroll_speed = 300.0f; /* pixels/s, what 5px/frame was at 60fps */
+
+	state->previous_x = state->x;
+	state->previous_y = state->y;
+
+	/* every pad plugged in pushes the view */
+	for (int i = 0; i < GAME_MAX_CONTROLLERS; ++i) {
+		const struct game_controller *controller = &input->controllers[i];
+
+		if (!controller->connected)
+			continue;
+
+		state->x -= controller->stick_x * scroll_speed * dt;
+		state->y -= controller->stick_y * scroll_speed * dt;
+	}
+}
+
+GAME_RENDER(game_render)
+{
+	struct game_state *state = get_game_state(memory);
+
+	const int xoffset = floorf(state->previous_x + (state->x - state->previous_x) * alpha);
+	const int yoffset = floorf(state->previous_y + (state->y - state->previous_y) * alpha);
+
+	/* a buffer of another size is a different surface, whatever it holds is stale */
+	if (state->drawn && xoffset == state->drawn_xoffset && yoffset == state->drawn_yoffset
+			&& buffer->width == state->drawn_width && buffer->height == state->drawn_height)
+		return;
+
+	/* scrolling moves every pixel of the gradient */
+	render(memory, buffer, xoffset, yoffset);
+	offscreen_buffer_mark_dirty(buffer, 0, 0, buffer->width, buffer->height);
+
+	state->drawn = 1;
+	state->drawn_xoffset = xoffset;
+	state->drawn_yoffset = yoffset;
+	state->drawn_width = buffer->width;
+	state->drawn_height = buffer->height;
 }
@@ -1,14 +1,149 @@
 #ifndef HANDMADE_PLATFORM
 #define HANDMADE_PLATFORM
 
+#include <stddef.h> /* size_t */
+
+#include "memory_arena.h"
+#include "work_queue.h"
+
+#define OFFSCREEN_MAX_DIRTY_RECTS 32
+
+struct dirty_rect
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+/*
+ * Drawing code marks every rectangle it changes and the platform only
+ * presents those, so a frame where little moves costs little. The list
+ * starts empty each frame.
+ */
 struct offscreen_buffer
 {
 	void *pixels;
 	size_t width;
 	size_t height;
 	size_t pitch;
+
+	unsigned int dirty_count;
+	struct dirty_rect dirty[OFFSCREEN_MAX_DIRTY_RECTS];
 };
 
-void render(struct offscreen_buffer *buffer, int xoffset, int yoffset);
+/* grows a to cover b */
+static inline void dirty_rect_union(struct dirty_rect *a, const struct dirty_rect *b)
+{
+	const int x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+	const int y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+
+	a->x = a->x < b->x ? a->x : b->x;
+	a->y = a->y < b->y ? a->y : b->y;
+	a->width = x1 - a->x;
+	a->height = y1 - a->y;
+}
+
+/*
+ * Adds a rectangle to a dirty list, clipped to width x height. Once the
+ * list is full everything collapses into one bounding rectangle.
+ */
+static inline void dirty_rect_add(
+	struct dirty_rect *list, unsigned int *count,
+	size_t width, size_t height, struct dirty_rect rect)
+{
+	const int x1 = rect.x + rect.width < (int)width ? rect.x + rect.width : (int)width;
+	const int y1 = rect.y + rect.height < (int)height ? rect.y + rect.height : (int)height;
+
+	rect.x = rect.x > 0 ? rect.x : 0;
+	rect.y = rect.y > 0 ? rect.y : 0;
+	rect.width = x1 - rect.x;
+	rect.height = y1 - rect.y;
+
+	if (rect.width <= 0 || rect.height <= 0)
+		return;
+
+	if (*count == OFFSCREEN_MAX_DIRTY_RECTS) {
+		for (unsigned int i = 1; i < *count; ++i)
+			dirty_rect_union(&list[0], &list[i]);
+		dirty_rect_union(&list[0], &rect);
+		*count = 1;
+		return;
+	}
+
+	list[(*count)++] = rect;
+}
+
+static inline void offscreen_buffer_mark_dirty(
+	struct offscreen_buffer *buffer, int x, int y, int width, int height)
+{
+	const struct dirty_rect rect = { x, y, width, height };
+	dirty_rect_add(buffer->dirty, &buffer->dirty_count, buffer->width, buffer->height, rect);
+}
+
+/*
+ * The game is built as a shared object the platform layer loads at startup
+ * and reloads whenever it is rebuilt. Anything that has to survive a reload
+ * lives in game_memory, which the platform owns; the game keeps no state
+ * of its own between calls.
+ */
+
+struct asset_pack;
+
+/* services the platform provides to the game */
+struct platform_api
+{
+	/* runs callback(context, i) for every i in [0, count) across the
+	 * render threads and returns once they have all finished */
+	void (*run_work)(
+		struct work_queue *queue,
+		work_queue_callback *callback, void *context, unsigned int count);
+	struct work_queue *render_queue;
+	/* mapped for the whole run, so pointers into it survive reloads; the
+	 * lookups in asset_pack.h treat NULL as an empty pack */
+	const struct asset_pack *assets;
+};
+
+struct game_memory
+{
+	/* zeroed by the platform and kept across reloads */
+	struct memory_arena permanent;
+	/* scratch space, reset by the platform at the start of every frame */
+	struct memory_arena transient;
+	struct platform_api platform;
+};
+
+#define GAME_MAX_CONTROLLERS 4
+
+struct game_controller
+{
+	int connected;
+	float stick_x;
+	float stick_y;
+};
+
+struct game_input
+{
+	/* by slot, disconnected ones are zeroed */
+	struct game_controller controllers[GAME_MAX_CONTROLLERS];
+};
+
+/* advances the game by one fixed step of dt seconds */
+#define GAME_UPDATE(name) \
+	void name(struct game_memory *memory, const struct game_input *input, float dt)
+typedef GAME_UPDATE(game_update_fn);
+
+/*
+ * Draws the game alpha of the way from the previous step to the current one.
+ * The buffer already holds the last frame drawn, so only what changed has
+ * to be drawn, and marked dirty.
+ */
+#define GAME_RENDER(name) \
+	void name(struct game_memory *memory, struct offscreen_buffer *buffer, float alpha)
+typedef GAME_RENDER(game_render_fn);
+
+/* looked up by these names in the shared object */
+GAME_UPDATE(game_update);
+GAME_RENDER(game_render);
 
 #endif /* HANDMADE_PLATFORM */
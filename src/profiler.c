@@ -0,0 +1,189 @@
+/* standard library */
+#include <stdlib.h> /* qsort */
+#include <string.h> /* memset */
+#include <errno.h>
+#include <time.h> /* clock_gettime */
+
+#include "profiler.h"
+
+static const char *stage_names[PROFILE_STAGE_COUNT] = {
+	"events",
+	"recording",
+	"audio",
+	"render",
+	"present",
+	"wait",
+};
+
+uint64_t profiler_now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+int profiler_init(struct profiler *profiler, struct memory_arena *arena, unsigned int capacity)
+{
+	memset(profiler, 0, sizeof(*profiler));
+
+	const size_t arena_marker = memory_arena_mark(arena);
+	struct frame_record *records = MEMORY_ARENA_PUSH_ARRAY(arena, struct frame_record, capacity);
+	uint32_t *scratch = MEMORY_ARENA_PUSH_ARRAY(arena, uint32_t, capacity);
+
+	if (!capacity || !records || !scratch) {
+		fprintf(stderr, "Unable to allocate profiler history\n");
+		memory_arena_pop(arena, arena_marker);
+		return 0;
+	}
+
+	profiler->records = records;
+	profiler->scratch = scratch;
+	profiler->capacity = capacity;
+	return 1;
+}
+
+/* records hold 32 bits, a stall longer than that reads as the longest time */
+static uint32_t saturate_ns(uint64_t ns)
+{
+	return ns < UINT32_MAX ? ns : UINT32_MAX;
+}
+
+void profiler_begin_frame(struct profiler *profiler)
+{
+	const uint64_t now = profiler_now_ns();
+
+	if (!profiler->capacity)
+		return;
+
+	if (profiler->in_frame) {
+		profiler->current.frame_ns = saturate_ns(now - profiler->current.start_ns);
+		profiler->records[profiler->next] = profiler->current;
+		profiler->next = (profiler->next + 1) % profiler->capacity;
+		if (profiler->count < profiler->capacity)
+			++profiler->count;
+		++profiler->frames;
+	}
+
+	memset(&profiler->current, 0, sizeof(profiler->current));
+	profiler->current.start_ns = now;
+	profiler->last_mark_ns = now;
+	profiler->in_frame = 1;
+}
+
+void profiler_mark(struct profiler *profiler, enum profile_stage stage)
+{
+	const uint64_t now = profiler_now_ns();
+
+	uint32_t *stage_ns = &profiler->current.stage_ns[stage];
+	*stage_ns = saturate_ns(*stage_ns + (now - profiler->last_mark_ns));
+	profiler->last_mark_ns = now;
+}
+
+/* index of the i-th oldest record */
+static unsigned int record_index(const struct profiler *profiler, unsigned int i)
+{
+	return (profiler->next + profiler->capacity - profiler->count + i) % profiler->capacity;
+}
+
+const struct frame_record *profiler_last_frame(const struct profiler *profiler)
+{
+	if (!profiler->count)
+		return NULL;
+
+	return &profiler->records[record_index(profiler, profiler->count - 1)];
+}
+
+double profiler_mean_frame_ns(const struct profiler *profiler, unsigned int count)
+{
+	if (count > profiler->count)
+		count = profiler->count;
+
+	if (!count)
+		return 0.0;
+
+	uint64_t total = 0;
+	for (unsigned int i = profiler->count - count; i < profiler->count; ++i)
+		total += profiler->records[record_index(profiler, i)].frame_ns;
+
+	return (double)total / count;
+}
+
+static int compare_uint32(const void *a, const void *b)
+{
+	const uint32_t lhs = *(const uint32_t*)a;
+	const uint32_t rhs = *(const uint32_t*)b;
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/* nearest-rank percentile of a sorted array */
+static uint32_t percentile(const uint32_t *sorted, unsigned int count, unsigned int percent)
+{
+	unsigned int rank = (count * percent + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+	return sorted[rank - 1];
+}
+
+/* stage PROFILE_STAGE_COUNT is the whole frame */
+static void report_line(struct profiler *profiler, FILE *file, int stage)
+{
+	const unsigned int count = profiler->count;
+	uint32_t *values = profiler->scratch;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		const struct frame_record *record = &profiler->records[record_index(profiler, i)];
+		values[i] = stage < PROFILE_STAGE_COUNT ? record->stage_ns[stage] : record->frame_ns;
+	}
+
+	qsort(values, count, sizeof(uint32_t), compare_uint32);
+
+	fprintf(file, "%-9s %9.3f %9.3f %9.3f %9.3f\n",
+		stage < PROFILE_STAGE_COUNT ? stage_names[stage] : "frame",
+		percentile(values, count, 50) * 1e-6,
+		percentile(values, count, 95) * 1e-6,
+		percentile(values, count, 99) * 1e-6,
+		values[count - 1] * 1e-6);
+}
+
+void profiler_report(struct profiler *profiler, FILE *file)
+{
+	if (!profiler->count)
+		return;
+
+	fprintf(file, "%u frames (ms)     p50       p95       p99       max\n", profiler->count);
+
+	for (int stage = 0; stage <= PROFILE_STAGE_COUNT; ++stage)
+		report_line(profiler, file, stage);
+}
+
+int profiler_dump(const struct profiler *profiler, const char *path)
+{
+	FILE *file = fopen(path, "w");
+
+	if (!file) {
+		fprintf(stderr, "Unable to open profile dump %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	fprintf(file, "frame,start_ns,frame_ns");
+	for (int stage = 0; stage < PROFILE_STAGE_COUNT; ++stage)
+		fprintf(file, ",%s_ns", stage_names[stage]);
+	fputc('\n', file);
+
+	const uint64_t first_frame = profiler->frames - profiler->count;
+
+	for (unsigned int i = 0; i < profiler->count; ++i) {
+		const struct frame_record *record = &profiler->records[record_index(profiler, i)];
+
+		fprintf(file, "%llu,%llu,%u",
+			(unsigned long long)(first_frame + i),
+			(unsigned long long)record->start_ns,
+			record->frame_ns);
+
+		for (int stage = 0; stage < PROFILE_STAGE_COUNT; ++stage)
+			fprintf(file, ",%u", record->stage_ns[stage]);
+		fputc('\n', file);
+	}
+
+	return fclose(file) == 0;
+}
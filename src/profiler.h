@@ -0,0 +1,71 @@
+#ifndef HANDMADE_PROFILER
+#define HANDMADE_PROFILER
+
+#include <stdint.h> /* uint32_t, uint64_t */
+#include <stdio.h> /* FILE */
+
+#include "memory_arena.h"
+
+/*
+ * Per-stage frame profiler. Each frame is split into stages by calling
+ * profiler_mark() as each one finishes; the time since the previous mark is
+ * charged to that stage. Finished frames go into a fixed ring of records
+ * that the report and dump functions read back. All times come from
+ * CLOCK_MONOTONIC.
+ */
+
+enum profile_stage
+{
+	PROFILE_EVENTS, /* the backend's poll_input: window events, joysticks, hotplug */
+	PROFILE_RECORDING, /* input recording or replay */
+	PROFILE_AUDIO, /* audio fill */
+	PROFILE_RENDER,
+	PROFILE_PRESENT, /* the backend's present */
+	PROFILE_WAIT, /* frame pacing sleep */
+	PROFILE_STAGE_COUNT
+};
+
+struct frame_record
+{
+	uint64_t start_ns;
+	/* saturate at UINT32_MAX, about 4.3 s, rather than wrap */
+	uint32_t frame_ns;
+	uint32_t stage_ns[PROFILE_STAGE_COUNT];
+};
+
+struct profiler
+{
+	struct frame_record *records;
+	uint32_t *scratch; /* sorted copies for percentiles */
+	unsigned int capacity;
+	unsigned int count; /* valid records, up to capacity */
+	unsigned int next; /* slot the next finished frame goes in */
+	uint64_t frames; /* finished since init */
+
+	struct frame_record current;
+	uint64_t last_mark_ns;
+	int in_frame;
+};
+
+uint64_t profiler_now_ns(void);
+
+/* takes the history out of arena, returns 0 if it doesn't fit */
+int profiler_init(struct profiler *profiler, struct memory_arena *arena, unsigned int capacity);
+
+/* finishes the previous frame, if any, and starts timing a new one */
+void profiler_begin_frame(struct profiler *profiler);
+void profiler_mark(struct profiler *profiler, enum profile_stage stage);
+
+/* most recent finished frame, or NULL */
+const struct frame_record *profiler_last_frame(const struct profiler *profiler);
+
+/* mean frame time over the newest count finished frames */
+double profiler_mean_frame_ns(const struct profiler *profiler, unsigned int count);
+
+/* p50/p95/p99/max per stage over the whole history */
+void profiler_report(struct profiler *profiler, FILE *file);
+
+/* writes the history as CSV, oldest frame first */
+int profiler_dump(const struct profiler *profiler, const char *path);
+
+#endif /* HANDMADE_PROFILER */
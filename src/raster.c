@@ -0,0 +1,380 @@
+/* standard library */
+#include <stdint.h> /* uint32_t */
+#include <string.h> /* memcpy */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86
+#include <immintrin.h> /* SSE2/AVX2 intrinsics */
+#endif
+
+#include "raster.h"
+
+/*
+ * Every kernel works on one row. Dividing by 255 is done as
+ * ((x + 128) * 257) >> 16, exact for every product of two bytes, which is
+ * also what _mm_mulhi_epu16 computes, so all the variants produce
+ * identical pixels.
+ */
+
+typedef void raster_fill_fn(uint32_t *to, uint32_t color, int count);
+
+/* to[i] = from[i] over to[i] */
+typedef void raster_blend_fn(uint32_t *to, const uint32_t *from, int count);
+
+/* to[i] = color over to[i] */
+typedef void raster_blend_color_fn(uint32_t *to, uint32_t color, int count);
+
+static inline uint32_t div255(uint32_t x)
+{
+	return ((x + 128) * 257) >> 16;
+}
+
+static inline uint32_t blend_pixel(uint32_t to, uint32_t from)
+{
+	const uint32_t inverse = 255 - (from >> 24);
+	uint32_t result = 0;
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		const uint32_t channel = ((from >> shift) & 255) + div255(((to >> shift) & 255) * inverse);
+		result |= (channel < 255 ? channel : 255) << shift;
+	}
+
+	return result;
+}
+
+static void raster_fill_scalar(uint32_t *to, uint32_t color, int count)
+{
+	for (int i = 0; i < count; ++i)
+		to[i] = color;
+}
+
+static void raster_blend_scalar(uint32_t *to, const uint32_t *from, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		/* transparent pixels are common in sprites, opaque ones more so */
+		if (from[i] >> 24 == 255)
+			to[i] = from[i];
+		else if (from[i])
+			to[i] = blend_pixel(to[i], from[i]);
+	}
+}
+
+static void raster_blend_color_scalar(uint32_t *to, uint32_t color, int count)
+{
+	for (int i = 0; i < count; ++i)
+		to[i] = blend_pixel(to[i], color);
+}
+
+#ifdef HANDMADE_X86
+
+static void raster_fill_sse2(uint32_t *to, uint32_t color, int count)
+{
+	const __m128i value = _mm_set1_epi32(color);
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128((__m128i*)(to + i), value);
+		_mm_storeu_si128((__m128i*)(to + i + 4), value);
+	}
+
+	raster_fill_scalar(to + i, color, count - i);
+}
+
+/* two pixels widened to 16 bit lanes, blended with their inverse alphas */
+static inline __m128i blend_half_sse2(__m128i to, __m128i inverse, __m128i from)
+{
+	const __m128i product = _mm_mullo_epi16(to, inverse);
+	const __m128i quotient = _mm_mulhi_epu16(
+		_mm_add_epi16(product, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+	return _mm_add_epi16(quotient, from);
+}
+
+/* 255 - alpha of each pixel in all four of its channels */
+static inline __m128i inverse_alpha_sse2(__m128i from)
+{
+	const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(from, 0xff), 0xff);
+	return _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+}
+
+static inline __m128i blend_sse2(__m128i to, __m128i from)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i from_lo = _mm_unpacklo_epi8(from, zero);
+	const __m128i from_hi = _mm_unpackhi_epi8(from, zero);
+
+	const __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(to, zero), inverse_alpha_sse2(from_lo), from_lo);
+	const __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(to, zero), inverse_alpha_sse2(from_hi), from_hi);
+
+	/* the pack saturates, like the scalar min */
+	return _mm_packus_epi16(lo, hi);
+}
+
+static void raster_blend_sse2(uint32_t *to, const uint32_t *from, int count)
+{
+	const __m128i opaque = _mm_set1_epi32(0xff000000);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i source = _mm_loadu_si128((const __m128i*)(from + i));
+
+		/* whole vectors of opaque or empty pixels skip the arithmetic */
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(source, opaque), opaque)) == 0xffff) {
+			_mm_storeu_si128((__m128i*)(to + i), source);
+			continue;
+		}
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(source, zero)) == 0xffff)
+			continue;
+
+		const __m128i destination = _mm_loadu_si128((const __m128i*)(to + i));
+		_mm_storeu_si128((__m128i*)(to + i), blend_sse2(destination, source));
+	}
+
+	raster_blend_scalar(to + i, from + i, count - i);
+}
+
+static void raster_blend_color_sse2(uint32_t *to, uint32_t color, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i from = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+	const __m128i inverse = inverse_alpha_sse2(from);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i destination = _mm_loadu_si128((const __m128i*)(to + i));
+
+		const __m128i lo = blend_half_sse2(_mm_unpacklo_epi8(destination, zero), inverse, from);
+		const __m128i hi = blend_half_sse2(_mm_unpackhi_epi8(destination, zero), inverse, from);
+
+		_mm_storeu_si128((__m128i*)(to + i), _mm_packus_epi16(lo, hi));
+	}
+
+	raster_blend_color_scalar(to + i, color, count - i);
+}
+
+__attribute__((target("avx2")))
+static void raster_fill_avx2(uint32_t *to, uint32_t color, int count)
+{
+	const __m256i value = _mm256_set1_epi32(color);
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		_mm256_storeu_si256((__m256i*)(to + i), value);
+		_mm256_storeu_si256((__m256i*)(to + i + 8), value);
+	}
+
+	raster_fill_sse2(to + i, color, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blend_half_avx2(__m256i to, __m256i inverse, __m256i from)
+{
+	const __m256i product = _mm256_mullo_epi16(to, inverse);
+	const __m256i quotient = _mm256_mulhi_epu16(
+		_mm256_add_epi16(product, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+	return _mm256_add_epi16(quotient, from);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i inverse_alpha_avx2(__m256i from)
+{
+	const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(from, 0xff), 0xff);
+	return _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+}
+
+/* unpack and pack both work within 128 bit lanes, so pixel order survives */
+__attribute__((target("avx2")))
+static void raster_blend_avx2(uint32_t *to, const uint32_t *from, int count)
+{
+	const __m256i opaque = _mm256_set1_epi32(0xff000000);
+	const __m256i zero = _mm256_setzero_si256();
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		const __m256i source = _mm256_loadu_si256((const __m256i*)(from + i));
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(source, opaque), opaque)) == -1) {
+			_mm256_storeu_si256((__m256i*)(to + i), source);
+			continue;
+		}
+
+		if (_mm256_testz_si256(source, source))
+			continue;
+
+		const __m256i destination = _mm256_loadu_si256((const __m256i*)(to + i));
+		const __m256i from_lo = _mm256_unpacklo_epi8(source, zero);
+		const __m256i from_hi = _mm256_unpackhi_epi8(source, zero);
+
+		const __m256i lo = blend_half_avx2(
+			_mm256_unpacklo_epi8(destination, zero), inverse_alpha_avx2(from_lo), from_lo);
+		const __m256i hi = blend_half_avx2(
+			_mm256_unpackhi_epi8(destination, zero), inverse_alpha_avx2(from_hi), from_hi);
+
+		_mm256_storeu_si256((__m256i*)(to + i), _mm256_packus_epi16(lo, hi));
+	}
+
+	raster_blend_sse2(to + i, from + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void raster_blend_color_avx2(uint32_t *to, uint32_t color, int count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i from = _mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero);
+	const __m256i inverse = inverse_alpha_avx2(from);
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		const __m256i destination = _mm256_loadu_si256((const __m256i*)(to + i));
+
+		const __m256i lo = blend_half_avx2(_mm256_unpacklo_epi8(destination, zero), inverse, from);
+		const __m256i hi = blend_half_avx2(_mm256_unpackhi_epi8(destination, zero), inverse, from);
+
+		_mm256_storeu_si256((__m256i*)(to + i), _mm256_packus_epi16(lo, hi));
+	}
+
+	raster_blend_color_sse2(to + i, color, count - i);
+}
+
+#endif /* HANDMADE_X86 */
+
+static raster_fill_fn *raster_fill;
+static raster_blend_fn *raster_blend;
+static raster_blend_color_fn *raster_blend_color;
+
+/* picks the widest kernels the cpu supports */
+static void select_raster_kernels(void)
+{
+	raster_fill = raster_fill_scalar;
+	raster_blend = raster_blend_scalar;
+	raster_blend_color = raster_blend_color_scalar;
+
+#ifdef HANDMADE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) {
+		raster_fill = raster_fill_sse2;
+		raster_blend = raster_blend_sse2;
+		raster_blend_color = raster_blend_color_sse2;
+	}
+
+	if (__builtin_cpu_supports("avx2")) {
+		raster_fill = raster_fill_avx2;
+		raster_blend = raster_blend_avx2;
+		raster_blend_color = raster_blend_color_avx2;
+	}
+#endif
+}
+
+/*
+ * Clips a width x height rectangle at x, y to the buffer. Returns 0 if
+ * nothing is left, otherwise the rectangle and how far its top left corner
+ * moved, which is where a bitmap starts reading.
+ */
+static int clip(
+	const struct offscreen_buffer *buffer, struct dirty_rect *rect, int *skip_x, int *skip_y)
+{
+	const int x0 = rect->x > 0 ? rect->x : 0;
+	const int y0 = rect->y > 0 ? rect->y : 0;
+	const int x1 = rect->x + rect->width < (int)buffer->width ? rect->x + rect->width : (int)buffer->width;
+	const int y1 = rect->y + rect->height < (int)buffer->height ? rect->y + rect->height : (int)buffer->height;
+
+	if (x1 <= x0 || y1 <= y0)
+		return 0;
+
+	*skip_x = x0 - rect->x;
+	*skip_y = y0 - rect->y;
+
+	rect->x = x0;
+	rect->y = y0;
+	rect->width = x1 - x0;
+	rect->height = y1 - y0;
+
+	return 1;
+}
+
+static inline uint32_t *buffer_row(const struct offscreen_buffer *buffer, int x, int y)
+{
+	return (uint32_t*)((uint8_t*)buffer->pixels + (size_t)y * buffer->pitch) + x;
+}
+
+void raster_fill_rect(
+	struct offscreen_buffer *buffer, int x, int y, int width, int height, uint32_t color)
+{
+	/* statics start out empty again after every reload */
+	if (!raster_fill)
+		select_raster_kernels();
+
+	struct dirty_rect rect = { x, y, width, height };
+	int skip_x, skip_y;
+
+	if (!clip(buffer, &rect, &skip_x, &skip_y))
+		return;
+
+	for (int row = 0; row < rect.height; ++row)
+		raster_fill(buffer_row(buffer, rect.x, rect.y + row), color, rect.width);
+
+	offscreen_buffer_mark_dirty(buffer, rect.x, rect.y, rect.width, rect.height);
+}
+
+void raster_blend_rect(
+	struct offscreen_buffer *buffer, int x, int y, int width, int height, uint32_t color)
+{
+	if (color >> 24 == 255) {
+		raster_fill_rect(buffer, x, y, width, height, color);
+		return;
+	}
+
+	if (!raster_blend_color)
+		select_raster_kernels();
+
+	struct dirty_rect rect = { x, y, width, height };
+	int skip_x, skip_y;
+
+	if (!color || !clip(buffer, &rect, &skip_x, &skip_y))
+		return;
+
+	for (int row = 0; row < rect.height; ++row)
+		raster_blend_color(buffer_row(buffer, rect.x, rect.y + row), color, rect.width);
+
+	offscreen_buffer_mark_dirty(buffer, rect.x, rect.y, rect.width, rect.height);
+}
+
+void raster_blit(
+	struct offscreen_buffer *buffer, const struct offscreen_buffer *bitmap, int x, int y)
+{
+	struct dirty_rect rect = { x, y, bitmap->width, bitmap->height };
+	int skip_x, skip_y;
+
+	if (!clip(buffer, &rect, &skip_x, &skip_y))
+		return;
+
+	/* libc's memcpy is already as wide as the cpu allows */
+	for (int row = 0; row < rect.height; ++row) {
+		memcpy(buffer_row(buffer, rect.x, rect.y + row),
+			buffer_row(bitmap, skip_x, skip_y + row), rect.width * 4);
+	}
+
+	offscreen_buffer_mark_dirty(buffer, rect.x, rect.y, rect.width, rect.height);
+}
+
+void raster_blit_blend(
+	struct offscreen_buffer *buffer, const struct offscreen_buffer *bitmap, int x, int y)
+{
+	if (!raster_blend)
+		select_raster_kernels();
+
+	struct dirty_rect rect = { x, y, bitmap->width, bitmap->height };
+	int skip_x, skip_y;
+
+	if (!clip(buffer, &rect, &skip_x, &skip_y))
+		return;
+
+	for (int row = 0; row < rect.height; ++row) {
+		raster_blend(buffer_row(buffer, rect.x, rect.y + row),
+			buffer_row(bitmap, skip_x, skip_y + row), rect.width);
+	}
+
+	offscreen_buffer_mark_dirty(buffer, rect.x, rect.y, rect.width, rect.height);
+}
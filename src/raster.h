@@ -0,0 +1,42 @@
+#ifndef HANDMADE_RASTER
+#define HANDMADE_RASTER
+
+#include <stdint.h> /* uint32_t */
+
+#include "platform.h"
+
+/*
+ * 2D drawing into an offscreen_buffer for the game layer.
+ *
+ * Colours and bitmaps are ARGB with premultiplied alpha, so blending is
+ * dst = src + dst * (255 - src alpha) / 255 per channel, rounded the same
+ * way by every kernel. Everything is clipped to the buffer, and whatever
+ * is drawn is marked dirty on it.
+ */
+
+/* pack a premultiplied colour from straight alpha components */
+static inline uint32_t raster_color(uint8_t alpha, uint8_t red, uint8_t green, uint8_t blue)
+{
+	return ((uint32_t)alpha << 24)
+		| ((uint32_t)((red * alpha + 127) / 255) << 16)
+		| ((uint32_t)((green * alpha + 127) / 255) << 8)
+		| (uint32_t)((blue * alpha + 127) / 255);
+}
+
+/* overwrites the rectangle with color, alpha included */
+void raster_fill_rect(
+	struct offscreen_buffer *buffer, int x, int y, int width, int height, uint32_t color);
+
+/* blends color over the rectangle */
+void raster_blend_rect(
+	struct offscreen_buffer *buffer, int x, int y, int width, int height, uint32_t color);
+
+/* copies bitmap with its top left corner at x, y */
+void raster_blit(
+	struct offscreen_buffer *buffer, const struct offscreen_buffer *bitmap, int x, int y);
+
+/* blends bitmap over the buffer with its top left corner at x, y */
+void raster_blit_blend(
+	struct offscreen_buffer *buffer, const struct offscreen_buffer *bitmap, int x, int y);
+
+#endif /* HANDMADE_RASTER */
@@ -0,0 +1,70 @@
+#include <math.h> /* sqrtf */
+#include <string.h> /* memset */
+
+#include "resolution_controller.h"
+
+/* fraction of the budget a frame is aimed at after a cut */
+#define RESOLUTION_HEADROOM 0.9f
+
+void resolution_controller_init(
+	struct resolution_controller *controller,
+	uint64_t budget_ns, float min_scale, float max_scale)
+{
+	memset(controller, 0, sizeof(*controller));
+
+	controller->min_scale = min_scale;
+	controller->max_scale = max_scale > min_scale ? max_scale : min_scale;
+	controller->scale = controller->max_scale;
+	controller->step = 0.05f;
+	controller->budget_ns = budget_ns;
+}
+
+static int change_scale(struct resolution_controller *controller, float scale)
+{
+	if (scale < controller->min_scale)
+		scale = controller->min_scale;
+	if (scale > controller->max_scale)
+		scale = controller->max_scale;
+
+	if (fabsf(scale - controller->scale) < 0.01f)
+		return 0;
+
+	controller->scale = scale;
+	controller->cost_ns = 0.0;
+	controller->frames_since_change = 0;
+	controller->frames_with_room = 0;
+	return 1;
+}
+
+int resolution_controller_update(struct resolution_controller *controller, uint64_t busy_ns)
+{
+	/* the first frames at a new scale redraw everything and aren't typical */
+	if (++controller->frames_since_change < RESOLUTION_SETTLE_FRAMES)
+		return 0;
+
+	if (controller->cost_ns == 0.0)
+		controller->cost_ns = busy_ns;
+	else
+		controller->cost_ns += (busy_ns - controller->cost_ns) * 0.2;
+
+	const float budget = controller->budget_ns;
+	const float cost = controller->cost_ns;
+	const float scale = controller->scale;
+
+	if (cost > budget) {
+		/* cost goes with the pixel count, the square of the scale */
+		return change_scale(controller, scale * sqrtf(budget * RESOLUTION_HEADROOM / cost));
+	}
+
+	const float raised = scale + controller->step;
+	const float raised_cost = cost * (raised * raised) / (scale * scale);
+
+	if (scale < controller->max_scale && raised_cost < budget * RESOLUTION_HEADROOM) {
+		if (++controller->frames_with_room >= RESOLUTION_RAISE_FRAMES)
+			return change_scale(controller, raised);
+	} else {
+		controller->frames_with_room = 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef HANDMADE_RESOLUTION_CONTROLLER
+#define HANDMADE_RESOLUTION_CONTROLLER
+
+#include <stdint.h> /* uint64_t */
+
+/*
+ * Picks the fraction of the window's resolution the game renders at so
+ * frames fit a time budget.
+ *
+ * The cost of a frame is the time the frame loop was busy, smoothed over a
+ * few frames, and is taken to grow with the pixel count, i.e. with the
+ * scale squared. Over budget, the scale drops straight away to what should
+ * fit with some headroom. Raising it is slow: only after RESOLUTION_RAISE_FRAMES
+ * frames in a row where a step up would still have fitted does it go up a
+ * step. After every change the controller waits a few frames for the cost
+ * at the new scale to show.
+ */
+
+#define RESOLUTION_SETTLE_FRAMES 8
+#define RESOLUTION_RAISE_FRAMES 60
+
+struct resolution_controller
+{
+	float scale;
+	float min_scale;
+	float max_scale;
+	float step;
+
+	uint64_t budget_ns;
+	double cost_ns; /* moving average, 0 until the first sample */
+
+	unsigned int frames_since_change;
+	unsigned int frames_with_room;
+};
+
+void resolution_controller_init(
+	struct resolution_controller *controller,
+	uint64_t budget_ns, float min_scale, float max_scale);
+
+/* feeds one frame's busy time, returns 1 when the scale changed */
+int resolution_controller_update(struct resolution_controller *controller, uint64_t busy_ns);
+
+#endif /* HANDMADE_RESOLUTION_CONTROLLER */
@@ -0,0 +1,162 @@
+#ifndef HANDMADE_RING_BUFFER
+#define HANDMADE_RING_BUFFER
+
+/*
+ * Single-producer/single-consumer ring buffer of fixed size frames.
+ *
+ * The producer only ever stores write_cursor and the consumer only ever
+ * stores read_cursor, so no locks are needed: each side publishes its cursor
+ * with a release store after touching the data and loads the other side's
+ * cursor with an acquire load before touching it. The cursors live on their
+ * own cache lines so the two threads don't fight over one line, and one
+ * frame is always left empty to tell a full ring from an empty one.
+ */
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t */
+#include <unistd.h> /* ftruncate(), sysconf(), syscall() */
+#include <sys/mman.h>
+#include <sys/syscall.h> /* SYS_memfd_create */
+#include <linux/memfd.h> /* MFD_CLOEXEC */
+
+#define RING_BUFFER_CACHE_LINE 64
+
+struct ring_buffer
+{
+	/* read-only once the ring is initialised */
+	unsigned int size; /* in frames */
+	unsigned int frame_size; /* in bytes */
+	void *data;
+
+	/* written by the producer only */
+	unsigned int write_cursor __attribute__((aligned(RING_BUFFER_CACHE_LINE)));
+
+	/* written by the consumer only */
+	unsigned int read_cursor __attribute__((aligned(RING_BUFFER_CACHE_LINE)));
+} __attribute__((aligned(RING_BUFFER_CACHE_LINE)));
+
+static inline void ring_buffer_init(
+	struct ring_buffer *buffer, void *data, unsigned int size, unsigned int frame_size)
+{
+	buffer->size = size;
+	buffer->frame_size = frame_size;
+	buffer->data = data;
+	__atomic_store_n(&buffer->write_cursor, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&buffer->read_cursor, 0, __ATOMIC_RELAXED);
+}
+
+static inline void *ring_buffer_frame(const struct ring_buffer *buffer, unsigned int cursor)
+{
+	return (char*)buffer->data + (size_t)cursor * buffer->frame_size;
+}
+
+/* frames between two cursors */
+static inline unsigned int ring_buffer_distance(
+	const struct ring_buffer *buffer, unsigned int from, unsigned int to)
+{
+	return to >= from ? to - from : buffer->size - from + to;
+}
+
+/*
+ * Mirrored storage
+ *
+ * The frames are mapped twice, back to back, from one memfd, so the frame
+ * after the last is the first again. From any cursor, a whole ring's worth
+ * of frames is one contiguous span. Readers and writers take
+ * ring_buffer_frame() at their cursor and go, never splitting at the
+ * wrap. The size rounds up to whole pages, so frame_size has to divide the
+ * page size.
+ */
+
+/* returns 0, with errno set, if the memory can't be mapped */
+static inline int ring_buffer_init_mirrored(
+	struct ring_buffer *buffer, unsigned int size, unsigned int frame_size)
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t bytes = ((size_t)size * frame_size + page_size - 1) / page_size * page_size;
+
+	if (!frame_size || page_size % frame_size)
+		return 0;
+
+	const int file_descriptor = syscall(SYS_memfd_create, "ring_buffer", MFD_CLOEXEC);
+	if (file_descriptor < 0)
+		return 0;
+
+	/* both halves are reserved together so nothing else lands between them */
+	uint8_t *data = MAP_FAILED;
+	if (ftruncate(file_descriptor, bytes) == 0)
+		data = mmap(NULL, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (data != MAP_FAILED
+			&& (mmap(data, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file_descriptor, 0) == MAP_FAILED
+				|| mmap(data + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file_descriptor, 0) == MAP_FAILED)) {
+		munmap(data, 2 * bytes);
+		data = MAP_FAILED;
+	}
+
+	/* the mappings keep the memory alive */
+	close(file_descriptor);
+
+	if (data == MAP_FAILED)
+		return 0;
+
+	ring_buffer_init(buffer, data, bytes / frame_size, frame_size);
+	return 1;
+}
+
+static inline void ring_buffer_destroy_mirrored(struct ring_buffer *buffer)
+{
+	munmap(buffer->data, 2 * (size_t)buffer->size * buffer->frame_size);
+	buffer->data = NULL;
+}
+
+/*
+ * Producer side
+ */
+
+/* number of frames the producer may write; loads the consumer's cursor */
+static inline unsigned int ring_buffer_write_available(const struct ring_buffer *buffer)
+{
+	const unsigned int write_cursor = __atomic_load_n(&buffer->write_cursor, __ATOMIC_RELAXED);
+	const unsigned int read_cursor = __atomic_load_n(&buffer->read_cursor, __ATOMIC_ACQUIRE);
+
+	return buffer->size - 1 - ring_buffer_distance(buffer, read_cursor, write_cursor);
+}
+
+/* frames written but not yet consumed, as seen from the producer */
+static inline unsigned int ring_buffer_fill(const struct ring_buffer *buffer)
+{
+	const unsigned int write_cursor = __atomic_load_n(&buffer->write_cursor, __ATOMIC_RELAXED);
+	const unsigned int read_cursor = __atomic_load_n(&buffer->read_cursor, __ATOMIC_ACQUIRE);
+
+	return ring_buffer_distance(buffer, read_cursor, write_cursor);
+}
+
+/* publishes frames written from the current write cursor */
+static inline void ring_buffer_commit_write(struct ring_buffer *buffer, unsigned int frames)
+{
+	const unsigned int write_cursor = __atomic_load_n(&buffer->write_cursor, __ATOMIC_RELAXED);
+	__atomic_store_n(&buffer->write_cursor, (write_cursor + frames) % buffer->size, __ATOMIC_RELEASE);
+}
+
+/*
+ * Consumer side
+ */
+
+/* number of frames the consumer may read; loads the producer's cursor */
+static inline unsigned int ring_buffer_read_available(const struct ring_buffer *buffer)
+{
+	const unsigned int read_cursor = __atomic_load_n(&buffer->read_cursor, __ATOMIC_RELAXED);
+	const unsigned int write_cursor = __atomic_load_n(&buffer->write_cursor, __ATOMIC_ACQUIRE);
+
+	return ring_buffer_distance(buffer, read_cursor, write_cursor);
+}
+
+/* hands frames read from the current read cursor back to the producer */
+static inline void ring_buffer_commit_read(struct ring_buffer *buffer, unsigned int frames)
+{
+	const unsigned int read_cursor = __atomic_load_n(&buffer->read_cursor, __ATOMIC_RELAXED);
+	__atomic_store_n(&buffer->read_cursor, (read_cursor + frames) % buffer->size, __ATOMIC_RELEASE);
+}
+
+#endif /* HANDMADE_RING_BUFFER */
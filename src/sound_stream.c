@@ -0,0 +1,320 @@
+/* standard library */
+#include <stdio.h> /* snprintf, fprintf */
+#include <string.h> /* memset, strerror */
+#include <errno.h>
+
+/* system headers */
+#include <fcntl.h> /* open() */
+#include <unistd.h> /* pread(), close() */
+#include <sys/stat.h>
+
+#include "sound_stream.h"
+#include "trace.h"
+
+/* how long the reader sleeps before checking its rings anyway, in ms */
+#define SOUND_STREAM_WAIT_TIMEOUT 100
+
+/* moves the reader's steps on unless the main thread has asked to close meanwhile */
+static void advance(struct sound_stream *stream, int from, int to)
+{
+	__atomic_compare_exchange_n(&stream->state, &from, to, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static int has_work(struct sound_stream *stream)
+{
+	switch (__atomic_load_n(&stream->state, __ATOMIC_ACQUIRE)) {
+		case SOUND_STREAM_OPENING:
+		case SOUND_STREAM_CLOSING:
+			return 1;
+
+		case SOUND_STREAM_PLAYING:
+			return ring_buffer_write_available(&stream->buffer) >= SOUND_STREAM_CHUNK_FRAMES;
+
+		default:
+			return 0;
+	}
+}
+
+static void open_track(struct sound_streamer *streamer, struct sound_stream *stream)
+{
+	uint8_t *header = stream->staging;
+	struct stat info;
+
+	stream->file_descriptor = open(stream->path, O_RDONLY | O_CLOEXEC);
+
+	if (stream->file_descriptor < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", stream->path, strerror(errno));
+		advance(stream, SOUND_STREAM_OPENING, SOUND_STREAM_FINISHED);
+		return;
+	}
+
+	/* the data chunk has to start in the first staging buffer's worth */
+	const ssize_t header_size = pread(stream->file_descriptor, header, SOUND_STREAM_STAGING_SIZE, 0);
+
+	if (header_size < 0 || fstat(stream->file_descriptor, &info) < 0
+			|| !wav_parse(&stream->format, stream->path, header, header_size, info.st_size)) {
+		close(stream->file_descriptor);
+		stream->file_descriptor = -1;
+		advance(stream, SOUND_STREAM_OPENING, SOUND_STREAM_FINISHED);
+		return;
+	}
+
+	stream->read_offset = 0;
+	stream->staging_size = 0;
+	stream->staging_position = 0;
+	stream->step = ((uint64_t)stream->format.sample_rate << 16) / streamer->sample_rate;
+	/* two source frames in before the first one comes out */
+	stream->phase = 2 << 16;
+	memset(stream->previous, 0, sizeof(stream->previous));
+	memset(stream->next, 0, sizeof(stream->next));
+
+	/* lets the kernel read further ahead than it would by default */
+	posix_fadvise(stream->file_descriptor, stream->format.data_offset, 0, POSIX_FADV_SEQUENTIAL);
+
+	advance(stream, SOUND_STREAM_OPENING, SOUND_STREAM_PLAYING);
+}
+
+/* the next source frame as stereo, returns 0 at the end of a track that doesn't loop */
+static int read_source_frame(struct sound_stream *stream, int16_t frame[2])
+{
+	const struct wav_format *format = &stream->format;
+
+	if (stream->staging_position + format->frame_size > stream->staging_size) {
+		if (stream->read_offset + format->frame_size > format->data_size) {
+			if (!stream->loop || format->data_size < format->frame_size)
+				return 0;
+			stream->read_offset = 0;
+		}
+
+		/* whole frames only, so none straddles two reads */
+		size_t size = format->data_size - stream->read_offset;
+		if (size > SOUND_STREAM_STAGING_SIZE)
+			size = SOUND_STREAM_STAGING_SIZE;
+		size -= size % format->frame_size;
+
+		const ssize_t result = pread(stream->file_descriptor, stream->staging, size,
+			format->data_offset + stream->read_offset);
+
+		if (result < (ssize_t)format->frame_size) {
+			if (result < 0)
+				fprintf(stderr, "Unable to read %s: %s\n", stream->path, strerror(errno));
+			return 0;
+		}
+
+		stream->staging_size = result - result % format->frame_size;
+		stream->staging_position = 0;
+		stream->read_offset += stream->staging_size;
+	}
+
+	const uint8_t *source = stream->staging + stream->staging_position;
+	const unsigned int sample_size = format->bits / 8;
+
+	/* mono goes to both sides, anything past stereo is dropped */
+	frame[0] = wav_sample_to_s16(source, format);
+	frame[1] = format->channels > 1 ? wav_sample_to_s16(source + sample_size, format) : frame[0];
+
+	stream->staging_position += format->frame_size;
+	return 1;
+}
+
+/* reads and resamples up to a chunk into the ring, linearly interpolating */
+static void fill_track(struct sound_stream *stream)
+{
+	TRACE_SCOPE("sound stream read");
+
+	struct ring_buffer *ring = &stream->buffer;
+	/* mirrored, a whole chunk fits from the cursor on */
+	int16_t *frames = ring_buffer_frame(ring, ring->write_cursor);
+	unsigned int written = 0;
+	int ended = 0;
+
+	while (written < SOUND_STREAM_CHUNK_FRAMES) {
+		while (stream->phase >= 1 << 16) {
+			stream->previous[0] = stream->next[0];
+			stream->previous[1] = stream->next[1];
+
+			if (!read_source_frame(stream, stream->next)) {
+				ended = 1;
+				break;
+			}
+
+			stream->phase -= 1 << 16;
+		}
+
+		if (ended)
+			break;
+
+		int16_t *frame = frames + 2 * written;
+		const int64_t t = stream->phase;
+
+		frame[0] = stream->previous[0] + (((stream->next[0] - stream->previous[0]) * t) >> 16);
+		frame[1] = stream->previous[1] + (((stream->next[1] - stream->previous[1]) * t) >> 16);
+
+		stream->phase += stream->step;
+		++written;
+	}
+
+	ring_buffer_commit_write(ring, written);
+
+	if (ended)
+		advance(stream, SOUND_STREAM_PLAYING, SOUND_STREAM_FINISHED);
+}
+
+static void *sound_streamer_thread_driver(void *context)
+{
+	struct sound_streamer *streamer = context;
+
+	TRACE_THREAD_NAME("sound streamer");
+
+	while (!__atomic_load_n(&streamer->quit, __ATOMIC_ACQUIRE)) {
+		int busy = 0;
+
+		for (int i = 0; i < SOUND_STREAM_MAX_TRACKS; ++i) {
+			struct sound_stream *stream = &streamer->tracks[i];
+
+			switch (__atomic_load_n(&stream->state, __ATOMIC_ACQUIRE)) {
+				case SOUND_STREAM_OPENING:
+					open_track(streamer, stream);
+					busy = 1;
+					break;
+
+				case SOUND_STREAM_PLAYING:
+					if (ring_buffer_write_available(&stream->buffer) >= SOUND_STREAM_CHUNK_FRAMES) {
+						fill_track(stream);
+						busy = 1;
+					}
+					break;
+
+				case SOUND_STREAM_CLOSING:
+					if (stream->file_descriptor >= 0)
+						close(stream->file_descriptor);
+					stream->file_descriptor = -1;
+					__atomic_store_n(&stream->state, SOUND_STREAM_FREE, __ATOMIC_RELEASE);
+					break;
+			}
+		}
+
+		if (busy)
+			continue;
+
+		waker_begin_wait(&streamer->wake);
+
+		int work = __atomic_load_n(&streamer->quit, __ATOMIC_ACQUIRE);
+		for (int i = 0; i < SOUND_STREAM_MAX_TRACKS && !work; ++i)
+			work = has_work(&streamer->tracks[i]);
+
+		if (!work)
+			waker_wait(&streamer->wake, -1, SOUND_STREAM_WAIT_TIMEOUT);
+
+		waker_end_wait(&streamer->wake);
+	}
+
+	for (int i = 0; i < SOUND_STREAM_MAX_TRACKS; ++i) {
+		if (streamer->tracks[i].file_descriptor >= 0)
+			close(streamer->tracks[i].file_descriptor);
+	}
+
+	return NULL;
+}
+
+int sound_streamer_start(struct sound_streamer *streamer, struct memory_arena *arena, unsigned int sample_rate)
+{
+	memset(streamer, 0, sizeof(*streamer));
+	streamer->sample_rate = sample_rate;
+
+	/* one frame of the ring always stays empty */
+	const unsigned int ring_size = SOUND_STREAM_CHUNKS * SOUND_STREAM_CHUNK_FRAMES + 1;
+	int track_count = 0;
+
+	for (; track_count < SOUND_STREAM_MAX_TRACKS; ++track_count) {
+		struct sound_stream *stream = &streamer->tracks[track_count];
+
+		stream->staging = memory_arena_push(arena, SOUND_STREAM_STAGING_SIZE, RING_BUFFER_CACHE_LINE);
+		stream->file_descriptor = -1;
+
+		if (!stream->staging || !ring_buffer_init_mirrored(&stream->buffer, ring_size, 2 * sizeof(int16_t))) {
+			fprintf(stderr, "Unable to allocate space for streaming sound\n");
+			break;
+		}
+	}
+
+	int has_waker = 0;
+	if (track_count == SOUND_STREAM_MAX_TRACKS) {
+		has_waker = waker_init(&streamer->wake);
+		if (!has_waker)
+			fprintf(stderr, "Unable to create sound streamer eventfd: %s\n", strerror(errno));
+	}
+
+	if (has_waker) {
+		const int status = pthread_create(&streamer->thread, NULL, sound_streamer_thread_driver, streamer);
+		if (!status)
+			return 1;
+
+		fprintf(stderr, "Unable to create sound streamer thread: %s\n", strerror(status));
+		waker_destroy(&streamer->wake);
+	}
+
+	while (track_count--)
+		ring_buffer_destroy_mirrored(&streamer->tracks[track_count].buffer);
+
+	return 0;
+}
+
+void sound_streamer_stop(struct sound_streamer *streamer)
+{
+	__atomic_store_n(&streamer->quit, 1, __ATOMIC_RELEASE);
+	waker_wake(&streamer->wake);
+
+	pthread_join(streamer->thread, NULL);
+	waker_destroy(&streamer->wake);
+
+	for (int i = 0; i < SOUND_STREAM_MAX_TRACKS; ++i)
+		ring_buffer_destroy_mirrored(&streamer->tracks[i].buffer);
+}
+
+struct sound_stream *sound_streamer_open(struct sound_streamer *streamer, const char *path, int loop)
+{
+	for (int i = 0; i < SOUND_STREAM_MAX_TRACKS; ++i) {
+		struct sound_stream *stream = &streamer->tracks[i];
+
+		if (__atomic_load_n(&stream->state, __ATOMIC_ACQUIRE) != SOUND_STREAM_FREE)
+			continue;
+
+		/* nobody else looks at a free track, so the ring can start over */
+		ring_buffer_init(&stream->buffer, stream->buffer.data, stream->buffer.size, stream->buffer.frame_size);
+		snprintf(stream->path, sizeof(stream->path), "%s", path);
+		stream->loop = loop;
+		stream->starved = 0;
+
+		__atomic_store_n(&stream->state, SOUND_STREAM_OPENING, __ATOMIC_RELEASE);
+		waker_wake(&streamer->wake);
+		return stream;
+	}
+
+	fprintf(stderr, "Unable to stream %s, all %d tracks are in use\n", path, SOUND_STREAM_MAX_TRACKS);
+	return NULL;
+}
+
+void sound_streamer_close(struct sound_streamer *streamer, struct sound_stream *stream)
+{
+	int state = __atomic_load_n(&stream->state, __ATOMIC_ACQUIRE);
+
+	/* the reader may be moving it on from OPENING or PLAYING right now */
+	while (state != SOUND_STREAM_FREE && state != SOUND_STREAM_CLOSING
+			&& !__atomic_compare_exchange_n(&stream->state, &state, SOUND_STREAM_CLOSING,
+				0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	}
+
+	waker_wake(&streamer->wake);
+}
+
+void sound_streamer_notify(struct sound_streamer *streamer)
+{
+	int work = 0;
+
+	for (int i = 0; i < SOUND_STREAM_MAX_TRACKS && !work; ++i)
+		work = has_work(&streamer->tracks[i]);
+
+	if (work)
+		waker_notify(&streamer->wake);
+}
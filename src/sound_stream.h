@@ -0,0 +1,102 @@
+#ifndef HANDMADE_SOUND_STREAM
+#define HANDMADE_SOUND_STREAM
+
+#include <stdint.h> /* int16_t */
+#include <limits.h> /* PATH_MAX */
+#include <pthread.h>
+
+#include "memory_arena.h"
+#include "ring_buffer.h"
+#include "waker.h"
+#include "wav.h"
+
+/*
+ * Music and ambience played straight from WAV files on disk. Each track
+ * holds a ring a few chunks long that a reader thread keeps topped up,
+ * reading a chunk at a time with pread() and converting it to stereo S16
+ * at the mixer's rate. The mixer only ever copies out of the ring, so the
+ * main thread never touches the file, not even to open it; if the reader
+ * falls behind, the track plays silence for a block rather than the frame
+ * waiting on the disk.
+ */
+
+/*
+ * The ring is read-ahead, not output latency: the mixer starts, stops and
+ * pans a track on the block it is asked to, whatever is queued behind it,
+ * and tracks are never seeked, so a deep ring costs only memory. What it
+ * buys is time the reader can spend stuck on the disk before the track
+ * starves. Four chunks of 4096 frames is about 340 ms at 48 kHz, with three
+ * chunks, 250 ms, still queued when the reader is woken. That covers a
+ * cold read from a spinning disk or a busy page cache with room to spare,
+ * for 64 KB a track. A chunk of 16 bit stereo is also the 16 KB the
+ * staging buffer reads at once, so each wake is about one pread() per track
+ * at the file's own rate.
+ */
+#define SOUND_STREAM_MAX_TRACKS 4
+#define SOUND_STREAM_CHUNK_FRAMES 4096 /* output frames read per wake */
+#define SOUND_STREAM_CHUNKS 4 /* ring length, in chunks */
+#define SOUND_STREAM_STAGING_SIZE (16 * 1024) /* file bytes read per pread() */
+
+enum sound_stream_state
+{
+	SOUND_STREAM_FREE, /* only the main thread may touch it */
+	SOUND_STREAM_OPENING, /* waiting for the reader to open the file */
+	SOUND_STREAM_PLAYING,
+	SOUND_STREAM_FINISHED, /* no more frames coming, the ring drains */
+	SOUND_STREAM_CLOSING, /* waiting for the reader to let go of the file */
+};
+
+struct sound_stream
+{
+	/* stored by whichever side the state table above says owns the next step */
+	int state;
+	/* blocks the mixer filled with silence waiting for the reader */
+	unsigned int starved;
+
+	/* stereo S16 frames, the reader produces and the mixer consumes */
+	struct ring_buffer buffer;
+
+	/* set by the main thread before OPENING */
+	char path[PATH_MAX];
+	int loop;
+
+	/* reader thread only */
+	int file_descriptor;
+	struct wav_format format;
+	size_t read_offset; /* bytes of the data chunk read so far */
+	uint8_t *staging;
+	unsigned int staging_size; /* bytes in staging */
+	unsigned int staging_position;
+	uint32_t step; /* source frames per output frame, 16.16 fixed point */
+	uint32_t phase; /* between previous and next, 16.16 */
+	int16_t previous[2];
+	int16_t next[2];
+};
+
+struct sound_streamer
+{
+	unsigned int sample_rate;
+	struct waker wake; /* the reader sleeps on it while every ring is full */
+	int quit;
+	pthread_t thread;
+	struct sound_stream tracks[SOUND_STREAM_MAX_TRACKS];
+};
+
+/* maps the rings and takes the staging buffers out of arena, returns 0 if the reader can't start */
+int sound_streamer_start(struct sound_streamer *streamer, struct memory_arena *arena, unsigned int sample_rate);
+void sound_streamer_stop(struct sound_streamer *streamer);
+
+/*
+ * Starts reading path in the background and returns the track to hand to
+ * mixer_play_stream(), or NULL if every track is in use. A file that turns
+ * out not to be playable just finishes without a sound.
+ */
+struct sound_stream *sound_streamer_open(struct sound_streamer *streamer, const char *path, int loop);
+
+/* stop the track's mixer voice first, the track is reused once the reader lets go */
+void sound_streamer_close(struct sound_streamer *streamer, struct sound_stream *stream);
+
+/* called by the main thread after mixing, wakes the reader if a ring has a chunk free */
+void sound_streamer_notify(struct sound_streamer *streamer);
+
+#endif /* HANDMADE_SOUND_STREAM */
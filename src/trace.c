@@ -0,0 +1,168 @@
+#include "trace.h"
+
+#ifdef HANDMADE_TRACE
+
+/* standard library */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h> /* fopen, fprintf */
+#include <stdlib.h> /* malloc */
+#include <string.h> /* strerror */
+#include <errno.h>
+#include <time.h> /* clock_gettime */
+
+/* system headers */
+#include <sys/syscall.h> /* SYS_gettid */
+#include <unistd.h> /* syscall */
+
+#define TRACE_EVENTS_PER_THREAD (1 << 18)
+
+struct trace_event
+{
+	uint64_t timestamp_ns;
+	const char *name;
+	char phase; /* 'B'egin or 'E'nd */
+};
+
+struct trace_buffer
+{
+	struct trace_buffer *next; /* global list of every thread's buffer */
+	const char *thread_name;
+	long thread_id;
+	unsigned int count; /* published with release stores */
+	unsigned int open_scopes; /* begun but not yet ended */
+	unsigned int dropped;
+	struct trace_event events[TRACE_EVENTS_PER_THREAD];
+};
+
+static struct trace_buffer *trace_buffers;
+static __thread struct trace_buffer *thread_buffer;
+static __thread int thread_buffer_failed;
+
+static struct trace_buffer *get_thread_buffer(void)
+{
+	if (thread_buffer || thread_buffer_failed)
+		return thread_buffer;
+
+	struct trace_buffer *buffer = malloc(sizeof(*buffer));
+
+	if (!buffer) {
+		thread_buffer_failed = 1;
+		return NULL;
+	}
+
+	buffer->thread_name = NULL;
+	buffer->thread_id = syscall(SYS_gettid);
+	buffer->count = 0;
+	buffer->open_scopes = 0;
+	buffer->dropped = 0;
+
+	/* push onto the global list, only ever prepended to */
+	buffer->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(
+			&trace_buffers, &buffer->next, buffer, 1,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	thread_buffer = buffer;
+	return buffer;
+}
+
+/* callers make sure there is room */
+static void record(struct trace_buffer *buffer, const char *name, char phase)
+{
+	const unsigned int count = buffer->count;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	struct trace_event *event = &buffer->events[count];
+	event->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+	event->name = name;
+	event->phase = phase;
+
+	__atomic_store_n(&buffer->count, count + 1, __ATOMIC_RELEASE);
+}
+
+struct trace_scope trace_begin_scope(const char *name)
+{
+	struct trace_scope scope = { name, 0 };
+	struct trace_buffer *buffer = get_thread_buffer();
+
+	if (!buffer)
+		return scope;
+
+	/* keep room for the end of every open scope so none is left unterminated */
+	if (buffer->count + buffer->open_scopes + 2 > TRACE_EVENTS_PER_THREAD) {
+		buffer->dropped += 2;
+		return scope;
+	}
+
+	record(buffer, name, 'B');
+	++buffer->open_scopes;
+	scope.recorded = 1;
+	return scope;
+}
+
+void trace_end_scope(struct trace_scope *scope)
+{
+	if (!scope->recorded)
+		return;
+
+	record(thread_buffer, scope->name, 'E');
+	--thread_buffer->open_scopes;
+}
+
+void trace_set_thread_name(const char *name)
+{
+	struct trace_buffer *buffer = get_thread_buffer();
+
+	if (buffer)
+		buffer->thread_name = name;
+}
+
+int trace_flush(const char *path)
+{
+	FILE *file = fopen(path, "w");
+
+	if (!file) {
+		fprintf(stderr, "Unable to open trace file %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	const long pid = getpid();
+	const char *separator = "";
+
+	fprintf(file, "{\"traceEvents\":[\n");
+
+	for (struct trace_buffer *buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+			buffer; buffer = buffer->next) {
+		/* threads may still be adding events, only read what's published */
+		const unsigned int count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+
+		if (buffer->thread_name) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,"
+				"\"args\":{\"name\":\"%s\"}}",
+				separator, pid, buffer->thread_id, buffer->thread_name);
+			separator = ",\n";
+		}
+
+		for (unsigned int i = 0; i < count; ++i) {
+			const struct trace_event *event = &buffer->events[i];
+
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%ld}",
+				separator, event->name, event->phase,
+				event->timestamp_ns * 1e-3, pid, buffer->thread_id);
+			separator = ",\n";
+		}
+
+		if (buffer->dropped) {
+			fprintf(stderr, "trace: thread %ld dropped %u events\n",
+				buffer->thread_id, buffer->dropped);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
+
+#endif /* HANDMADE_TRACE */
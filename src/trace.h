@@ -0,0 +1,47 @@
+#ifndef HANDMADE_TRACE_H
+#define HANDMADE_TRACE_H
+
+/*
+ * Scoped trace markers, compiled in with -DHANDMADE_TRACE.
+ *
+ *   TRACE_SCOPE("render");
+ *
+ * records a begin event where it appears and the matching end event when
+ * the enclosing block exits. Every thread appends to its own fixed size
+ * buffer (no locks, full buffers drop whole scopes) and trace_flush()
+ * writes all of them out as Chrome trace JSON, which chrome://tracing and
+ * Perfetto open. Names must be string literals since only the pointer is
+ * stored.
+ *
+ * Without HANDMADE_TRACE the macros expand to nothing.
+ */
+
+#ifdef HANDMADE_TRACE
+
+struct trace_scope
+{
+	const char *name;
+	int recorded; /* the end is only recorded if the begin was */
+};
+
+struct trace_scope trace_begin_scope(const char *name);
+void trace_end_scope(struct trace_scope *scope);
+void trace_set_thread_name(const char *name);
+int trace_flush(const char *path);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(name) \
+	struct trace_scope TRACE_CONCAT(trace_scope_, __LINE__) \
+		__attribute__((cleanup(trace_end_scope))) = trace_begin_scope(name)
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+
+#endif /* HANDMADE_TRACE */
+
+#endif /* HANDMADE_TRACE_H */
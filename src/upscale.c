@@ -0,0 +1,372 @@
+/* standard library */
+#include <stdint.h> /* uint32_t */
+#include <string.h> /* memcpy */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86
+#include <immintrin.h> /* SSE2/AVX2 intrinsics */
+#endif
+
+#include "upscale.h"
+#include "trace.h"
+
+/* rows handed to a worker at a time */
+#define UPSCALE_BAND_HEIGHT 16
+
+/*
+ * Source positions are 16.16 fixed point. Every kernel steps them the same
+ * way and blends with 8 bit weights in 16 bit lanes, so all the variants
+ * produce identical pixels.
+ */
+
+/* copies row[pos >> 16] for count pixels, pos advancing by step */
+typedef void upscale_nearest_fn(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count);
+
+/* to[i] = row0[i] * (256 - weight) / 256 + row1[i] * weight / 256 */
+typedef void upscale_blend_fn(
+	uint32_t *to, const uint32_t *row0, const uint32_t *row1,
+	unsigned int count, unsigned int weight);
+
+/* like nearest, but blends row[x] and row[x + 1] by the position's fraction */
+typedef void upscale_lerp_fn(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count);
+
+/* position of the sample centred on pixel i of a size pixel row, in a
+ * from pixel row */
+static inline uint32_t sample_position(uint64_t i, uint64_t from, uint64_t size)
+{
+	return ((2 * i + 1) * from << 16) / (2 * size);
+}
+
+/* left neighbour for bilinear filtering, clamped to the first pixel */
+static inline uint32_t bilinear_position(uint32_t position)
+{
+	return position > 32768 ? position - 32768 : 0;
+}
+
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t weight)
+{
+	const uint32_t inverse = 256 - weight;
+	const uint32_t rb = (((a & 0x00ff00ff) * inverse + (b & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+	const uint32_t ag = (((a >> 8) & 0x00ff00ff) * inverse + ((b >> 8) & 0x00ff00ff) * weight) & 0xff00ff00;
+	return rb | ag;
+}
+
+static void upscale_nearest_scalar(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i)
+		to[i] = row[(pos + i * step) >> 16];
+}
+
+static void upscale_blend_scalar(
+	uint32_t *to, const uint32_t *row0, const uint32_t *row1,
+	unsigned int count, unsigned int weight)
+{
+	for (unsigned int i = 0; i < count; ++i)
+		to[i] = lerp_pixel(row0[i], row1[i], weight);
+}
+
+static void upscale_lerp_scalar(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		const uint32_t sample = bilinear_position(pos + i * step);
+		const uint32_t x = sample >> 16;
+		to[i] = lerp_pixel(row[x], row[x + 1], (sample >> 8) & 255);
+	}
+}
+
+#ifdef HANDMADE_X86
+
+static void upscale_blend_sse2(
+	uint32_t *to, const uint32_t *row0, const uint32_t *row1,
+	unsigned int count, unsigned int weight)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i inverse = _mm_set1_epi16(256 - weight);
+	const __m128i forward = _mm_set1_epi16(weight);
+	unsigned int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(row0 + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(row1 + i));
+
+		const __m128i lo = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), inverse),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), forward)), 8);
+		const __m128i hi = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), inverse),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), forward)), 8);
+
+		_mm_storeu_si128((__m128i*)(to + i), _mm_packus_epi16(lo, hi));
+	}
+
+	upscale_blend_scalar(to + i, row0 + i, row1 + i, count - i, weight);
+}
+
+/* both neighbours of one output pixel, weighted and summed into the low half */
+static inline __m128i lerp_pair_sse2(const uint32_t *row, uint32_t pos)
+{
+	const uint32_t sample = bilinear_position(pos);
+	const short weight = (sample >> 8) & 255;
+	const short inverse = 256 - weight;
+
+	const __m128i pair = _mm_unpacklo_epi8(
+		_mm_loadl_epi64((const __m128i*)(row + (sample >> 16))), _mm_setzero_si128());
+	const __m128i weights = _mm_set_epi16(
+		weight, weight, weight, weight, inverse, inverse, inverse, inverse);
+
+	const __m128i product = _mm_mullo_epi16(pair, weights);
+	return _mm_add_epi16(product, _mm_srli_si128(product, 8));
+}
+
+static void upscale_lerp_sse2(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count)
+{
+	unsigned int i = 0;
+
+	for (; i + 2 <= count; i += 2) {
+		const __m128i first = lerp_pair_sse2(row, pos + i * step);
+		const __m128i second = lerp_pair_sse2(row, pos + (i + 1) * step);
+
+		const __m128i sum = _mm_srli_epi16(_mm_unpacklo_epi64(first, second), 8);
+		_mm_storel_epi64((__m128i*)(to + i), _mm_packus_epi16(sum, sum));
+	}
+
+	upscale_lerp_scalar(to + i, row, pos + i * step, step, count - i);
+}
+
+__attribute__((target("avx2")))
+static void upscale_nearest_avx2(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count)
+{
+	const __m256i lanes = _mm256_mullo_epi32(
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+	const __m256i advance = _mm256_set1_epi32(step * 8);
+	__m256i position = _mm256_add_epi32(_mm256_set1_epi32(pos), lanes);
+	unsigned int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		const __m256i index = _mm256_srli_epi32(position, 16);
+		_mm256_storeu_si256((__m256i*)(to + i), _mm256_i32gather_epi32((const int*)row, index, 4));
+		position = _mm256_add_epi32(position, advance);
+	}
+
+	upscale_nearest_scalar(to + i, row, pos + i * step, step, count - i);
+}
+
+__attribute__((target("avx2")))
+static void upscale_blend_avx2(
+	uint32_t *to, const uint32_t *row0, const uint32_t *row1,
+	unsigned int count, unsigned int weight)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i inverse = _mm256_set1_epi16(256 - weight);
+	const __m256i forward = _mm256_set1_epi16(weight);
+	unsigned int i = 0;
+
+	/* unpack and pack both work within 128 bit lanes, so pixel order survives */
+	for (; i + 8 <= count; i += 8) {
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + i));
+
+		const __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), inverse),
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), forward)), 8);
+		const __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), inverse),
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), forward)), 8);
+
+		_mm256_storeu_si256((__m256i*)(to + i), _mm256_packus_epi16(lo, hi));
+	}
+
+	upscale_blend_sse2(to + i, row0 + i, row1 + i, count - i, weight);
+}
+
+__attribute__((target("avx2")))
+static void upscale_lerp_avx2(
+	uint32_t *to, const uint32_t *row, uint32_t pos, uint32_t step, unsigned int count)
+{
+	const __m128i lanes = _mm_setr_epi32(0, step, 2 * step, 3 * step);
+	const __m128i advance = _mm_set1_epi32(4 * step);
+	const __m128i half = _mm_set1_epi32(32768);
+	const __m128i fraction = _mm_set1_epi32(255);
+	const __m128i full = _mm_set1_epi32(256);
+	const __m256i zero = _mm256_setzero_si256();
+
+	/* spreads each pixel's inverse and weight words over the four channels
+	 * of its left and right neighbour */
+	const __m256i spread_even = _mm256_setr_epi8(
+		0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3,
+		0, 1, 0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 2, 3);
+	const __m256i spread_odd = _mm256_setr_epi8(
+		8, 9, 8, 9, 8, 9, 8, 9, 10, 11, 10, 11, 10, 11, 10, 11,
+		8, 9, 8, 9, 8, 9, 8, 9, 10, 11, 10, 11, 10, 11, 10, 11);
+
+	__m128i position = _mm_add_epi32(_mm_set1_epi32(pos), lanes);
+	unsigned int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const __m128i sample = _mm_max_epi32(_mm_sub_epi32(position, half), _mm_setzero_si128());
+		const __m128i weight = _mm_and_si128(_mm_srli_epi32(sample, 8), fraction);
+		const __m128i weights = _mm_or_si128(
+			_mm_sub_epi32(full, weight), _mm_slli_epi32(weight, 16));
+
+		/* left and right neighbours of pixels 0 and 1 in the low lane, 2 and 3 high */
+		const __m256i pairs = _mm256_i32gather_epi64(
+			(const long long*)row, _mm_srli_epi32(sample, 16), 4);
+		const __m256i spread = _mm256_cvtepu32_epi64(weights);
+
+		const __m256i even = _mm256_mullo_epi16(
+			_mm256_unpacklo_epi8(pairs, zero), _mm256_shuffle_epi8(spread, spread_even));
+		const __m256i odd = _mm256_mullo_epi16(
+			_mm256_unpackhi_epi8(pairs, zero), _mm256_shuffle_epi8(spread, spread_odd));
+
+		const __m256i sum = _mm256_srli_epi16(_mm256_unpacklo_epi64(
+			_mm256_add_epi16(even, _mm256_srli_si256(even, 8)),
+			_mm256_add_epi16(odd, _mm256_srli_si256(odd, 8))), 8);
+
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+		_mm_storeu_si128((__m128i*)(to + i), _mm256_castsi256_si128(packed));
+
+		position = _mm_add_epi32(position, advance);
+	}
+
+	upscale_lerp_sse2(to + i, row, pos + i * step, step, count - i);
+}
+
+#endif /* HANDMADE_X86 */
+
+static upscale_nearest_fn *upscale_nearest;
+static upscale_blend_fn *upscale_blend;
+static upscale_lerp_fn *upscale_lerp;
+
+static void select_upscale_kernels(void)
+{
+	upscale_nearest = upscale_nearest_scalar;
+	upscale_blend = upscale_blend_scalar;
+	upscale_lerp = upscale_lerp_scalar;
+
+#ifdef HANDMADE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) {
+		upscale_blend = upscale_blend_sse2;
+		upscale_lerp = upscale_lerp_sse2;
+	}
+
+	if (__builtin_cpu_supports("avx2")) {
+		upscale_nearest = upscale_nearest_avx2;
+		upscale_blend = upscale_blend_avx2;
+		upscale_lerp = upscale_lerp_avx2;
+	}
+#endif
+}
+
+struct upscale_job
+{
+	struct offscreen_buffer *to;
+	const struct offscreen_buffer *from;
+	struct dirty_rect rect;
+	enum upscale_filter filter;
+	uint32_t first_x; /* source position of the rect's first column */
+	uint32_t step_x;
+};
+
+static void upscale_band(void *context, unsigned int band)
+{
+	const struct upscale_job *job = context;
+	const struct offscreen_buffer *from = job->from;
+	const struct offscreen_buffer *to = job->to;
+	const struct dirty_rect *rect = &job->rect;
+
+	const int y_begin = rect->y + band * UPSCALE_BAND_HEIGHT;
+	const int y_end = y_begin + UPSCALE_BAND_HEIGHT < rect->y + rect->height
+		? y_begin + UPSCALE_BAND_HEIGHT : rect->y + rect->height;
+
+	/* source columns the bilinear filter reads for this rect */
+	const uint32_t first_column = bilinear_position(job->first_x) >> 16;
+	const uint32_t last_column = bilinear_position(job->first_x + (rect->width - 1) * job->step_x) >> 16;
+	const uint32_t end_column = last_column + 1 < from->width ? last_column + 1 : from->width - 1;
+
+	uint32_t blended[UPSCALE_MAX_SOURCE_WIDTH + 1];
+
+	for (int y = y_begin; y < y_end; ++y) {
+		uint32_t *out = (uint32_t*)((uint8_t*)to->pixels + y * to->pitch) + rect->x;
+		const uint32_t position = sample_position(y, from->height, to->height);
+
+		if (job->filter == UPSCALE_NEAREST) {
+			const uint32_t *row = (const uint32_t*)((const uint8_t*)from->pixels + (position >> 16) * from->pitch);
+			upscale_nearest(out, row, job->first_x, job->step_x, rect->width);
+			continue;
+		}
+
+		const uint32_t sample = bilinear_position(position);
+		const uint32_t y0 = sample >> 16;
+		const uint32_t y1 = y0 + 1 < from->height ? y0 + 1 : y0;
+		const unsigned int weight = (sample >> 8) & 255;
+
+		const uint32_t *row0 = (const uint32_t*)((const uint8_t*)from->pixels + y0 * from->pitch);
+		const uint32_t *row1 = (const uint32_t*)((const uint8_t*)from->pixels + y1 * from->pitch);
+		const unsigned int columns = end_column - first_column + 1;
+
+		if (weight)
+			upscale_blend(blended + first_column, row0 + first_column, row1 + first_column, columns, weight);
+		else
+			memcpy(blended + first_column, row0 + first_column, columns * sizeof(uint32_t));
+
+		/* the last column's right neighbour is itself */
+		if (end_column == last_column)
+			blended[end_column + 1] = blended[end_column];
+
+		upscale_lerp(out, blended, job->first_x, job->step_x, rect->width);
+	}
+}
+
+void upscale(
+	struct work_queue *queue,
+	struct offscreen_buffer *to, const struct offscreen_buffer *from,
+	const struct dirty_rect *rect, enum upscale_filter filter)
+{
+	TRACE_SCOPE("upscale");
+
+	if (!upscale_blend)
+		select_upscale_kernels();
+
+	if (rect->width <= 0 || rect->height <= 0)
+		return;
+
+	struct upscale_job job;
+	job.to = to;
+	job.from = from;
+	job.rect = *rect;
+	job.filter = from->width > UPSCALE_MAX_SOURCE_WIDTH ? UPSCALE_NEAREST : filter;
+	job.step_x = ((uint64_t)from->width << 16) / to->width;
+	/* stepped from column 0 like the kernels step, so a pixel samples the
+	 * same spot whichever rect it is upscaled in */
+	job.first_x = sample_position(0, from->width, to->width) + rect->x * job.step_x;
+
+	const unsigned int bands = (rect->height + UPSCALE_BAND_HEIGHT - 1) / UPSCALE_BAND_HEIGHT;
+	work_queue_run(queue, upscale_band, &job, bands);
+}
+
+struct dirty_rect upscale_dirty_rect(
+	const struct offscreen_buffer *to, const struct offscreen_buffer *from,
+	const struct dirty_rect *rect)
+{
+	/* a source pixel feeds the output pixels sampling it or either neighbour */
+	const long x0 = (long)(rect->x - 1) * (long)to->width / (long)from->width - 1;
+	const long y0 = (long)(rect->y - 1) * (long)to->height / (long)from->height - 1;
+	const long x1 = ((long)(rect->x + rect->width + 1) * to->width + from->width - 1) / from->width + 1;
+	const long y1 = ((long)(rect->y + rect->height + 1) * to->height + from->height - 1) / from->height + 1;
+
+	struct dirty_rect result;
+	result.x = x0 > 0 ? x0 : 0;
+	result.y = y0 > 0 ? y0 : 0;
+	result.width = (x1 < (long)to->width ? x1 : (long)to->width) - result.x;
+	result.height = (y1 < (long)to->height ? y1 : (long)to->height) - result.y;
+
+	return result;
+}
@@ -0,0 +1,34 @@
+#ifndef HANDMADE_UPSCALE
+#define HANDMADE_UPSCALE
+
+#include "platform.h"
+#include "work_queue.h"
+
+/*
+ * Stretches a frame rendered at a lower internal resolution over the
+ * buffer that gets presented. Sample positions are pixel centres, so the
+ * image stays put as the ratio changes, and rows are split into bands run
+ * across the work queue.
+ */
+
+enum upscale_filter
+{
+	UPSCALE_NEAREST,
+	UPSCALE_BILINEAR,
+};
+
+/* widest source the bilinear filter takes, wider ones fall back to nearest */
+#define UPSCALE_MAX_SOURCE_WIDTH 8192
+
+/* stretches all of from over all of to, writing only the pixels inside rect */
+void upscale(
+	struct work_queue *queue,
+	struct offscreen_buffer *to, const struct offscreen_buffer *from,
+	const struct dirty_rect *rect, enum upscale_filter filter);
+
+/* the part of to a change inside rect of from can reach */
+struct dirty_rect upscale_dirty_rect(
+	const struct offscreen_buffer *to, const struct offscreen_buffer *from,
+	const struct dirty_rect *rect);
+
+#endif /* HANDMADE_UPSCALE */
@@ -0,0 +1,93 @@
+#ifndef HANDMADE_WAKER
+#define HANDMADE_WAKER
+
+#include <stdint.h> /* uint64_t */
+#include <poll.h>
+#include <unistd.h> /* read(), write(), close() */
+#include <sys/eventfd.h>
+
+/*
+ * Lets a thread sleep until another one has work for it, without a
+ * syscall on the producing side while the sleeper is awake. The sleeper
+ * raises the waiting flag, checks for work again, and only then sleeps on
+ * the eventfd:
+ *
+ *   waker_begin_wait(waker);
+ *   if (!work)
+ *       waker_wait(waker, -1, timeout);
+ *   waker_end_wait(waker);
+ *
+ * The producer publishes its work and then calls waker_notify(), which
+ * only writes the eventfd if it finds the flag raised. Both sides fence
+ * between their store and their load, so at least one of them sees the
+ * other's.
+ */
+
+struct waker
+{
+	int fd; /* eventfd the sleeper polls */
+	int waiting; /* raised by the sleeper from begin to end of a wait */
+};
+
+/* returns 0, with errno set, if the eventfd can't be created */
+static inline int waker_init(struct waker *waker)
+{
+	waker->waiting = 0;
+	waker->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return waker->fd >= 0;
+}
+
+static inline void waker_destroy(struct waker *waker)
+{
+	close(waker->fd);
+}
+
+/* wakes the sleeper whether or not it is waiting, e.g. to tell it to quit */
+static inline void waker_wake(struct waker *waker)
+{
+	const uint64_t one = 1;
+	if (write(waker->fd, &one, sizeof(one)) < 0) {
+		/* counter overflow only, the sleeper is awake anyway */
+	}
+}
+
+/* called after publishing work, only pays for the syscall if the sleeper is asleep */
+static inline void waker_notify(struct waker *waker)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_exchange_n(&waker->waiting, 0, __ATOMIC_SEQ_CST))
+		waker_wake(waker);
+}
+
+/* sleeper side, before the last check for work */
+static inline void waker_begin_wait(struct waker *waker)
+{
+	__atomic_store_n(&waker->waiting, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ * Sleeps until woken, other_fd is readable or timeout ms pass (-1 waits
+ * for ever). Pass -1 for other_fd to wait on the waker alone.
+ */
+static inline void waker_wait(struct waker *waker, int other_fd, int timeout)
+{
+	struct pollfd pfds[2] = {
+		{ waker->fd, POLLIN, 0 },
+		{ other_fd, POLLIN, 0 }, /* poll() skips negative descriptors */
+	};
+
+	if (poll(pfds, 2, timeout) > 0 && pfds[0].revents) {
+		uint64_t count;
+		if (read(waker->fd, &count, sizeof(count)) < 0) {
+			/* EAGAIN, nothing to drain */
+		}
+	}
+}
+
+static inline void waker_end_wait(struct waker *waker)
+{
+	__atomic_store_n(&waker->waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+#endif /* HANDMADE_WAKER */
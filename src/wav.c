@@ -0,0 +1,90 @@
+/* standard library */
+#include <stdio.h> /* fprintf */
+#include <string.h> /* memcmp, memcpy, memset */
+
+#include "byte_read.h"
+#include "wav.h"
+
+int wav_parse(
+	struct wav_format *format, const char *path,
+	const uint8_t *bytes, size_t size, size_t file_size)
+{
+	memset(format, 0, sizeof(*format));
+
+	if (size < 12 || memcmp(bytes, "RIFF", 4) || memcmp(bytes + 8, "WAVE", 4)) {
+		fprintf(stderr, "%s is not a WAV file\n", path);
+		return 0;
+	}
+
+	const uint8_t *format_chunk = NULL;
+	uint32_t format_size = 0;
+	int has_data = 0;
+
+	for (size_t offset = 12; offset + 8 <= size && !has_data;) {
+		const uint32_t chunk_size = read_u32(bytes + offset + 4);
+		const size_t available = file_size - offset - 8;
+
+		if (!memcmp(bytes + offset, "fmt ", 4) && chunk_size >= 16 && chunk_size <= size - offset - 8) {
+			format_chunk = bytes + offset + 8;
+			format_size = chunk_size;
+		} else if (!memcmp(bytes + offset, "data", 4)) {
+			/* streamed writers leave the size at 0 or too big */
+			format->data_offset = offset + 8;
+			format->data_size = chunk_size && chunk_size <= available ? chunk_size : available;
+			has_data = 1;
+		}
+
+		/* chunks are padded to even sizes */
+		offset += 8 + (size_t)chunk_size + (chunk_size & 1);
+	}
+
+	if (!format_chunk || !has_data) {
+		fprintf(stderr, "%s: WAV file has no format or data\n", path);
+		return 0;
+	}
+
+	uint16_t tag = read_u16(format_chunk);
+	format->channels = read_u16(format_chunk + 2);
+	format->sample_rate = read_u32(format_chunk + 4);
+	format->bits = read_u16(format_chunk + 14);
+
+	/* WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the sub format */
+	if (tag == 0xfffe && format_size >= 26)
+		tag = read_u16(format_chunk + 24);
+
+	format->is_float = tag == 3 && format->bits == 32;
+
+	if ((tag != 1 && !format->is_float)
+			|| (format->bits != 8 && format->bits != 16 && format->bits != 24 && format->bits != 32)
+			|| format->channels < 1 || format->channels > WAV_MAX_CHANNELS || !format->sample_rate) {
+		fprintf(stderr, "%s: only PCM and 32 bit float WAVs of up to %d channels are supported\n",
+			path, WAV_MAX_CHANNELS);
+		return 0;
+	}
+
+	format->frame_size = format->channels * format->bits / 8;
+	return 1;
+}
+
+int16_t wav_sample_to_s16(const uint8_t *sample, const struct wav_format *format)
+{
+	if (format->is_float) {
+		float value;
+		const uint32_t raw = read_u32(sample);
+		memcpy(&value, &raw, sizeof(value));
+
+		/* NaN fails every comparison and would convert to garbage */
+		if (!(value == value))
+			value = 0.0f;
+
+		value = value > 1.0f ? 1.0f : value < -1.0f ? -1.0f : value;
+		return (int16_t)(value * 32767.0f);
+	}
+
+	switch (format->bits) {
+		case 8: return (int16_t)((sample[0] - 128) << 8);
+		case 16: return (int16_t)read_u16(sample);
+		case 24: return (int16_t)read_u16(sample + 1);
+		default: return (int16_t)read_u16(sample + 2);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef HANDMADE_WAV
+#define HANDMADE_WAV
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t, int16_t */
+
+/*
+ * Just enough of the WAV format to find the samples: PCM at 8, 16, 24 or
+ * 32 bits and 32 bit float, up to WAV_MAX_CHANNELS channels, plain or
+ * WAVE_FORMAT_EXTENSIBLE. Shared by the asset packer, which converts whole
+ * files, and the sound streamer, which reads them a chunk at a time.
+ */
+
+#define WAV_MAX_CHANNELS 8
+
+struct wav_format
+{
+	unsigned int channels;
+	unsigned int sample_rate;
+	unsigned int bits;
+	int is_float;
+	unsigned int frame_size; /* bytes per frame, all channels */
+	size_t data_offset; /* of the first sample from the start of the file */
+	size_t data_size;
+};
+
+/*
+ * Finds the format and data chunks in the start of a file, bytes being
+ * the first size of its file_size bytes. The data chunk has to start
+ * inside bytes, and its size is trusted no further than the end of the
+ * file. Returns 0, having said why, if the file can't be used.
+ */
+int wav_parse(
+	struct wav_format *format, const char *path,
+	const uint8_t *bytes, size_t size, size_t file_size);
+
+/* one sample in the file's encoding to S16 */
+int16_t wav_sample_to_s16(const uint8_t *sample, const struct wav_format *format);
+
+#endif /* HANDMADE_WAV */
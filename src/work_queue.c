@@ -0,0 +1,166 @@
+/* standard library */
+#include <stdio.h> /* fprintf */
+#include <string.h> /* strerror */
+
+/* system headers */
+#include <pthread.h>
+
+#include "work_queue.h"
+#include "trace.h"
+
+struct work_queue
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+
+	/* current batch, only changed while no worker is busy */
+	work_queue_callback *callback;
+	void *context;
+	unsigned int count;
+	unsigned int generation;
+	unsigned int busy;
+	int quit;
+
+	/* claimed with atomic increments, outside the mutex */
+	unsigned int next_index;
+
+	unsigned int worker_count;
+	pthread_t workers[];
+};
+
+/* claims and runs jobs until the batch has none left */
+static void work_queue_drain(struct work_queue *queue)
+{
+	TRACE_SCOPE("work_queue_drain");
+
+	work_queue_callback *const callback = queue->callback;
+	void *const context = queue->context;
+	const unsigned int count = queue->count;
+
+	for (;;) {
+		const unsigned int index = __atomic_fetch_add(&queue->next_index, 1, __ATOMIC_RELAXED);
+		if (index >= count)
+			break;
+		callback(context, index);
+	}
+}
+
+static void *work_queue_thread_driver(void *context)
+{
+	struct work_queue *queue = context;
+	unsigned int seen_generation = 0;
+
+	TRACE_THREAD_NAME("worker");
+
+	pthread_mutex_lock(&queue->mutex);
+	for (;;) {
+		while (queue->generation == seen_generation && !queue->quit)
+			pthread_cond_wait(&queue->work_ready, &queue->mutex);
+
+		if (queue->quit)
+			break;
+
+		seen_generation = queue->generation;
+		++queue->busy;
+		pthread_mutex_unlock(&queue->mutex);
+
+		work_queue_drain(queue);
+
+		pthread_mutex_lock(&queue->mutex);
+		if (!--queue->busy)
+			pthread_cond_signal(&queue->work_done);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	return NULL;
+}
+
+struct work_queue *work_queue_create(struct memory_arena *arena, unsigned int worker_count)
+{
+	struct work_queue *queue = memory_arena_push_zero(
+		arena, sizeof(*queue) + worker_count * sizeof(pthread_t), __alignof__(struct work_queue));
+
+	if (!queue) {
+		fprintf(stderr, "Unable to allocate work queue\n");
+		return NULL;
+	}
+
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->work_ready, NULL);
+	pthread_cond_init(&queue->work_done, NULL);
+
+	for (unsigned int i = 0; i < worker_count; ++i) {
+		const int status = pthread_create(
+			&queue->workers[i], NULL, work_queue_thread_driver, queue);
+
+		if (status) {
+			/* run with however many threads we managed to start */
+			fprintf(stderr, "Unable to create worker thread: %s\n", strerror(status));
+			break;
+		}
+
+		++queue->worker_count;
+	}
+
+	return queue;
+}
+
+void work_queue_destroy(struct work_queue *queue)
+{
+	if (!queue)
+		return;
+
+	pthread_mutex_lock(&queue->mutex);
+	queue->quit = 1;
+	pthread_cond_broadcast(&queue->work_ready);
+	pthread_mutex_unlock(&queue->mutex);
+
+	for (unsigned int i = 0; i < queue->worker_count; ++i)
+		pthread_join(queue->workers[i], NULL);
+
+	pthread_cond_destroy(&queue->work_done);
+	pthread_cond_destroy(&queue->work_ready);
+	pthread_mutex_destroy(&queue->mutex);
+}
+
+unsigned int work_queue_thread_count(const struct work_queue *queue)
+{
+	/* the thread calling work_queue_run() works too */
+	return queue ? queue->worker_count + 1 : 1;
+}
+
+void work_queue_run(
+	struct work_queue *queue,
+	work_queue_callback *callback, void *context, unsigned int count)
+{
+	if (!queue || !queue->worker_count || count <= 1) {
+		for (unsigned int i = 0; i < count; ++i)
+			callback(context, i);
+		return;
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+
+	/* a worker that woke too late for the previous batch may still be
+	 * claiming (empty) indices from it, let it leave before reusing the
+	 * counter */
+	while (queue->busy)
+		pthread_cond_wait(&queue->work_done, &queue->mutex);
+
+	queue->callback = callback;
+	queue->context = context;
+	queue->count = count;
+	queue->next_index = 0;
+	++queue->generation;
+	pthread_cond_broadcast(&queue->work_ready);
+	pthread_mutex_unlock(&queue->mutex);
+
+	work_queue_drain(queue);
+
+	/* every index has been claimed, wait for the ones still running */
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->busy)
+		pthread_cond_wait(&queue->work_done, &queue->mutex);
+	pthread_mutex_unlock(&queue->mutex);
+}
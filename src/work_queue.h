@@ -0,0 +1,26 @@
+#ifndef HANDMADE_WORK_QUEUE
+#define HANDMADE_WORK_QUEUE
+
+#include "memory_arena.h"
+
+/*
+ * A persistent pool of worker threads that run batches of indexed jobs.
+ * work_queue_run() hands out indices [0, count) from a shared counter to the
+ * workers and the calling thread, and returns once every job has finished.
+ */
+struct work_queue;
+
+typedef void work_queue_callback(void *context, unsigned int index);
+
+/* takes the queue out of arena, returns NULL if it doesn't fit */
+struct work_queue *work_queue_create(struct memory_arena *arena, unsigned int worker_count);
+/* joins the workers, the memory goes with the arena */
+void work_queue_destroy(struct work_queue *queue);
+
+unsigned int work_queue_thread_count(const struct work_queue *queue);
+
+void work_queue_run(
+	struct work_queue *queue,
+	work_queue_callback *callback, void *context, unsigned int count);
+
+#endif /* HANDMADE_WORK_QUEUE */